@@ -7,6 +7,7 @@
 
 #include "arena.h"
 
+#include <chrono>
 #include <stdexcept>
 
 #include "act-iter.h"
@@ -235,6 +236,16 @@ namespace arena
 
     static bool miscasts            = false;
 
+    // Headless mode skips all display, delays and messages, so that many
+    // trials can be run quickly for statistics.
+    static bool headless            = false;
+    static string results_format;   // "csv", "json", or empty for none
+    static FILE *results_file       = nullptr;
+    static chrono::steady_clock::time_point trial_start;
+
+    static const int MAX_TRIALS          = 99;
+    static const int MAX_HEADLESS_TRIALS = 100000;
+
     static int  summon_throttle     = INT_MAX;
 
     static vector<monster_type> uniques_list;
@@ -458,9 +469,20 @@ namespace arena
         cycle_random   = strip_tag(spec, "cycle_random");
         name_monsters  = strip_tag(spec, "names");
         random_uniques = strip_tag(spec, "random_uniques");
+        headless       = strip_tag(spec, "headless");
+
+        results_format = strip_tag_prefix(spec, "results:");
+        if (!results_format.empty() && results_format != "csv"
+            && results_format != "json")
+        {
+            throw arena_error_nonfatal_f("Unknown results format \"%s\"; "
+                                         "expected csv or json",
+                                         results_format.c_str());
+        }
 
         const int ntrials = strip_number_tag(spec, "t:");
-        if (ntrials != TAG_UNFOUND && ntrials >= 1 && ntrials <= 99
+        if (ntrials != TAG_UNFOUND && ntrials >= 1
+            && ntrials <= (headless ? MAX_HEADLESS_TRIALS : MAX_TRIALS)
             && !total_trials)
         {
             total_trials = ntrials;
@@ -557,6 +579,9 @@ namespace arena
 
     static void show_fight_banner(bool after_fight = false)
     {
+        if (headless)
+            return;
+
         int line = 1;
 
         cgotoxy(1, line++, GOTO_STAT);
@@ -859,10 +884,55 @@ namespace arena
         is_respawning = false;
     }
 
+    static void open_results_file()
+    {
+        if (results_format.empty() || results_file)
+            return;
+
+        const string filename = "arena." + results_format;
+        results_file = fopen(filename.c_str(), "w");
+        if (!results_file)
+            throw arena_error_f("Couldn't open %s", filename.c_str());
+
+        if (results_format == "csv")
+            fprintf(results_file, "trial,turns,winner,wall_ms\n");
+    }
+
+    // Record the outcome of the trial just finished, one line per trial so
+    // that a long run can be read while it is still going.
+    static void write_trial_result(bool was_tied)
+    {
+        if (!results_file)
+            return;
+
+        const char *winner = was_tied ? "tie"
+                           : faction_a.won ? "A" : "B";
+        const long long wall_ms =
+            chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - trial_start).count();
+
+        if (results_format == "csv")
+        {
+            fprintf(results_file, "%d,%d,%s,%lld\n",
+                    trials_done, turns, winner, wall_ms);
+        }
+        else
+        {
+            fprintf(results_file,
+                    "{\"trial\": %d, \"turns\": %d, \"winner\": \"%s\", "
+                    "\"wall_ms\": %lld}\n",
+                    trials_done, turns, winner, wall_ms);
+        }
+        fflush(results_file);
+    }
+
     static void do_fight()
     {
-        viewwindow();
-        update_screen();
+        if (!headless)
+        {
+            viewwindow();
+            update_screen();
+        }
         clear_messages(true);
 
         {
@@ -870,7 +940,8 @@ namespace arena
             while (fight_is_on() && !contest_cancelled)
             {
 #ifdef ARENA_VERBOSE
-                mprf("---- Turn #%d ----", turns);
+                if (!headless)
+                    mprf("---- Turn #%d ----", turns);
 #endif
 
                 // Check the consistency of our book-keeping every 100 turns.
@@ -884,12 +955,12 @@ namespace arena
                 do_respawn(faction_a);
                 do_respawn(faction_b);
                 balance_spawners();
-                if (!contest_cancelled)
+                if (!contest_cancelled && !headless)
                     ui::delay(Options.view_delay);
                 clear_messages();
                 ASSERT(you.pet_target == MHITNOT);
             }
-            if (!contest_cancelled)
+            if (!contest_cancelled && !headless)
             {
                 viewwindow();
                 update_screen();
@@ -957,6 +1028,7 @@ namespace arena
         else if (faction_a.won)
             team_a_wins++;
 
+        write_trial_result(was_tied);
         show_fight_banner(true);
 
         string msg;
@@ -988,6 +1060,8 @@ namespace arena
         arena_type = "";
         place = level_id(BRANCH_DEPTHS, 1);
         arena_log = "";
+        headless = false;
+        results_format = "";
 
         // [ds] Turning off view_lock crashes arena.
         Options.view_lock_x = Options.view_lock_y = true;
@@ -1013,8 +1087,11 @@ namespace arena
     {
         if (file != nullptr)
             fclose(file);
+        if (results_file != nullptr)
+            fclose(results_file);
 
         file = nullptr;
+        results_file = nullptr;
         arena_log = "";
     }
 
@@ -1070,14 +1147,24 @@ namespace arena
             };
         };
 
+        // In headless mode nothing is drawn and there is no way to cancel
+        // the contest from the keyboard.
         auto ui = make_shared<UIArena>();
-        ui::push_layout(ui);
+        if (!headless)
+            ui::push_layout(ui);
+
+        // Messages still reach arena.result through the tee if
+        // arena_dump_msgs is set.
+        msg::suppress quiet(headless);
+        unwind_bool no_redraw(crawl_state.arena_headless, headless);
 
         do
         {
             try
             {
+                trial_start = chrono::steady_clock::now();
                 setup_fight();
+                open_results_file();
             }
             catch (const arena_error &error)
             {
@@ -1087,13 +1174,13 @@ namespace arena
             }
             do_fight();
 
-            if (!contest_cancelled && trials_done < total_trials)
+            if (!contest_cancelled && trials_done < total_trials && !headless)
                 ui::delay(Options.view_delay * 5);
         }
         while (!contest_cancelled && trials_done < total_trials);
 
         // why extra delay?
-        if (!contest_cancelled)
+        if (!contest_cancelled && !headless)
             ui::delay(Options.view_delay * 5);
 
         if (trials_done > 0)
@@ -1110,11 +1197,12 @@ namespace arena
             }
 
             mpr("---- Contest finished ----\n" + outcome);
-            if (!skipped_arena_ui)
+            if (!skipped_arena_ui && !headless)
                 _results_popup(outcome);
         }
 
-        ui::pop_layout();
+        if (!headless)
+            ui::pop_layout();
 
         write_results();
     }
@@ -10,15 +10,15 @@
 bit_vector::bit_vector(unsigned long s)
     : size(s)
 {
-    nwords = static_cast<int>((size + LONGSIZE - 1) / LONGSIZE);
-    data = new unsigned long[nwords];
+    nwords = static_cast<int>((size + WORDSIZE - 1) / WORDSIZE);
+    data = new uint64_t[nwords];
     reset();
 }
 
 bit_vector::bit_vector(const bit_vector& other) : size(other.size)
 {
-    nwords = static_cast<int>((size + LONGSIZE - 1) / LONGSIZE);
-    data = new unsigned long[nwords];
+    nwords = static_cast<int>((size + WORDSIZE - 1) / WORDSIZE);
+    data = new uint64_t[nwords];
     for (int w = 0; w < nwords; ++w)
         data[w] = other.data[w];
 }
@@ -28,6 +28,23 @@ bit_vector::~bit_vector()
     delete[] data;
 }
 
+bit_vector& bit_vector::operator = (const bit_vector& other)
+{
+    if (this == &other)
+        return *this;
+
+    if (nwords != other.nwords)
+    {
+        delete[] data;
+        nwords = other.nwords;
+        data = new uint64_t[nwords];
+    }
+    size = other.size;
+    for (int w = 0; w < nwords; ++w)
+        data[w] = other.data[w];
+    return *this;
+}
+
 void bit_vector::reset()
 {
     for (int w = 0; w < nwords; ++w)
@@ -37,20 +54,20 @@ void bit_vector::reset()
 bool bit_vector::get(unsigned long index) const
 {
     ASSERT(index < size);
-    int w = index / LONGSIZE;
-    int b = index % LONGSIZE;
-    return data[w] & (1UL << b);
+    int w = index / WORDSIZE;
+    int b = index % WORDSIZE;
+    return data[w] & (UINT64_C(1) << b);
 }
 
 void bit_vector::set(unsigned long index, bool value)
 {
     ASSERT(index < size);
-    int w = index / LONGSIZE;
-    int b = index % LONGSIZE;
+    int w = index / WORDSIZE;
+    int b = index % WORDSIZE;
     if (value)
-        data[w] |= (1UL << b);
+        data[w] |= (UINT64_C(1) << b);
     else
-        data[w] &= ~(1UL << b);
+        data[w] &= ~(UINT64_C(1) << b);
 }
 
 bit_vector& bit_vector::operator |= (const bit_vector& other)
@@ -77,3 +94,60 @@ bit_vector bit_vector::operator & (const bit_vector& other) const
         res.data[w] = data[w] & other.data[w];
     return res;
 }
+
+bit_vector& bit_vector::or_and(const bit_vector& a, const bit_vector& b)
+{
+    ASSERT(size == a.size);
+    ASSERT(size == b.size);
+    for (int w = 0; w < nwords; ++w)
+        data[w] |= a.data[w] & b.data[w];
+    return *this;
+}
+
+static int _lowest_set_bit(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int b = 0;
+    while (!(word & 1))
+    {
+        word >>= 1;
+        ++b;
+    }
+    return b;
+#endif
+}
+
+unsigned long bit_vector::next_set(unsigned long start) const
+{
+    if (start >= size)
+        return size;
+
+    int w = start / WORDSIZE;
+    uint64_t set = data[w] & (~UINT64_C(0) << (start % WORDSIZE));
+    while (!set)
+    {
+        if (++w == nwords)
+            return size;
+        set = data[w];
+    }
+    return w * WORDSIZE + _lowest_set_bit(set);
+}
+
+unsigned long bit_vector::next_unset(unsigned long start) const
+{
+    if (start >= size)
+        return size;
+
+    int w = start / WORDSIZE;
+    // Treat the bits before start as set.
+    uint64_t unset = ~data[w] & (~UINT64_C(0) << (start % WORDSIZE));
+    while (!unset)
+    {
+        if (++w == nwords)
+            return size;
+        unset = ~data[w];
+    }
+    return min<unsigned long>(size, w * WORDSIZE + _lowest_set_bit(unset));
+}
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <bitset>
+#include <cstdint>
 #include <vector>
 
 #include "debug.h"
@@ -24,6 +25,8 @@ public:
     bit_vector(const bit_vector& other);
     ~bit_vector();
 
+    bit_vector& operator = (const bit_vector& other);
+
     void reset();
 
     bool get(unsigned long index) const;
@@ -33,13 +36,21 @@ public:
     bit_vector& operator &= (const bit_vector& other);
     bit_vector  operator & (const bit_vector& other) const;
 
+    // Equivalent to *this |= a & b, without the temporary.
+    bit_vector& or_and(const bit_vector& a, const bit_vector& b);
+
+    // The first index >= start whose bit is set, or size if none.
+    unsigned long next_set(unsigned long start) const;
+    // The first index >= start whose bit is not set, or size if none.
+    unsigned long next_unset(unsigned long start) const;
+
 protected:
     unsigned long size;
     int nwords;
-    unsigned long *data;
+    uint64_t *data;
 };
 
-#define LONGSIZE (sizeof(unsigned long)*8)
+#define WORDSIZE (sizeof(uint64_t)*8)
 #ifndef ULONG_MAX
 #define ULONG_MAX ((unsigned long)(-1))
 #endif
@@ -104,6 +115,16 @@ public:
         return *this;
     }
 
+    inline bool operator==(const FixedBitVector<SIZE>&x) const
+    {
+        return data == x.data;
+    }
+
+    inline bool operator!=(const FixedBitVector<SIZE>&x) const
+    {
+        return data != x.data;
+    }
+
     void init(bool value)
     {
         data.reset();
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <random>
+
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "dgn-proclayouts.h"
+
+static vector<coord_def> _shuffled_area(const coord_def &tl, int w, int h,
+                                        unsigned int seed)
+{
+    vector<coord_def> points;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            points.push_back(tl + coord_def(x, y));
+
+    shuffle(points.begin(), points.end(), mt19937(seed));
+    return points;
+}
+
+TEST_CASE("ProceduralTileCache", "[single-file]")
+{
+    // Every miss computes one whole 4x4 tile, and a hit computes nothing.
+    int computed = 0;
+    auto value = [&computed](const coord_def &c)
+    {
+        ++computed;
+        return c.x * 1000 + c.y;
+    };
+
+    SECTION("Returns the computed value for every cell, including negative "
+            "coordinates")
+    {
+        ProceduralTileCache<int, 4> cache(64);
+
+        // x from -9 to 9 spans tiles -3 to 2, y from -7 to 7 tiles -2 to 1.
+        const vector<coord_def> area = _shuffled_area(coord_def(-9, -7),
+                                                      19, 15, 1);
+        for (const coord_def &c : area)
+            REQUIRE(cache.get(c, value) == c.x * 1000 + c.y);
+        REQUIRE(computed == 6 * 4 * 16);
+
+        // Everything is cached now.
+        for (const coord_def &c : area)
+            REQUIRE(cache.get(c, value) == c.x * 1000 + c.y);
+        REQUIRE(computed == 6 * 4 * 16);
+    }
+
+    SECTION("Hits within a tile and misses across tiles")
+    {
+        ProceduralTileCache<int, 4> cache(3);
+        int misses = 0;
+        auto get = [&](coord_def c, bool hit)
+        {
+            CAPTURE(c.x, c.y, hit);
+            REQUIRE(cache.get(c, value) == c.x * 1000 + c.y);
+            if (!hit)
+                ++misses;
+            REQUIRE(computed == misses * 16);
+        };
+
+        get(coord_def(0, 0), false);    // tile (0, 0)
+        get(coord_def(3, 3), true);
+        get(coord_def(-1, 0), false);   // tile (-1, 0), not (0, 0)
+        get(coord_def(-4, 3), true);
+        get(coord_def(-4, -4), false);  // tile (-1, -1)
+        get(coord_def(-1, -1), true);
+        get(coord_def(2, 1), true);
+
+        // A fourth tile doesn't fit, so the cache starts over.
+        get(coord_def(4, 0), false);    // tile (1, 0)
+        get(coord_def(0, 0), false);
+        get(coord_def(7, 3), true);
+        get(coord_def(-1, -1), false);
+
+        cache.clear();
+        get(coord_def(7, 3), false);
+        REQUIRE(misses == 7);
+    }
+}
+
+TEST_CASE("RiverLayout warp cache matches the scalar path", "[single-file]")
+{
+    const ColumnLayout columns(2, 6);
+    const NewAbyssLayout new_abyss(7629);
+
+    const uint32_t seed = GENERATE(1800u, 7u, 314159u);
+    const uint32_t offset = GENERATE(0u, 137u, 5000u, 123456u);
+    CAPTURE(seed, offset);
+
+    const RiverLayout scalar(seed, new_abyss, false);
+    const RiverLayout cached(seed, new_abyss);
+    const RiverLayout scalar_columns(seed + 1, columns, false);
+    const RiverLayout cached_columns(seed + 1, columns);
+
+    // Abyss coordinates drift a long way from the origin in both directions.
+    for (const coord_def &origin : { coord_def(0, 0), coord_def(-2000, 1500),
+                                     coord_def(40000, -37000) })
+    {
+        for (const coord_def &p : _shuffled_area(origin - coord_def(40, 35),
+                                                 80, 70, seed ^ offset))
+        {
+            CAPTURE(p.x, p.y);
+
+            const ProceduralSample a = scalar(p, offset);
+            const ProceduralSample b = cached(p, offset);
+            REQUIRE(a.feat() == b.feat());
+            REQUIRE(a.changepoint() == b.changepoint());
+
+            const ProceduralSample c = scalar_columns(p, offset);
+            const ProceduralSample d = cached_columns(p, offset);
+            REQUIRE(c.feat() == d.feat());
+            REQUIRE(c.changepoint() == d.changepoint());
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "env.h"
+#include "mon-act.h"
+#include "random.h"
+
+TEST_CASE("monster_action_queue pops highest energy first", "[single-file]")
+{
+    monster_action_queue queue;
+    REQUIRE(queue.empty());
+
+    queue.push(&env.mons[0], 80);
+    queue.push(&env.mons[1], 120);
+    queue.push(&env.mons[2], -5);
+    queue.push(&env.mons[3], 0);
+    queue.push(&env.mons[4], 95);
+    queue.push(&env.mons[5], -20);
+
+    REQUIRE(queue.size() == 6);
+    REQUIRE(queue.peek().first == &env.mons[1]);
+    REQUIRE(queue.pop() == make_pair(&env.mons[1], 120));
+    REQUIRE(queue.pop() == make_pair(&env.mons[4], 95));
+    REQUIRE(queue.pop() == make_pair(&env.mons[0], 80));
+    REQUIRE(queue.pop() == make_pair(&env.mons[3], 0));
+    REQUIRE(queue.pop() == make_pair(&env.mons[2], -5));
+    REQUIRE(queue.pop() == make_pair(&env.mons[5], -20));
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("monster_action_queue pops equal energies in queue order",
+          "[single-file]")
+{
+    monster_action_queue queue;
+    for (int i = 0; i < 6; ++i)
+        queue.push(&env.mons[i], i % 2 ? 100 : -10);
+
+    // Requeueing at the energy being popped goes to the back of the line.
+    REQUIRE(queue.pop().first == &env.mons[1]);
+    queue.push(&env.mons[1], 100);
+    REQUIRE(queue.pop().first == &env.mons[3]);
+    REQUIRE(queue.pop().first == &env.mons[5]);
+    REQUIRE(queue.pop().first == &env.mons[1]);
+    REQUIRE(queue.pop().first == &env.mons[0]);
+    REQUIRE(queue.pop().first == &env.mons[2]);
+    REQUIRE(queue.pop().first == &env.mons[4]);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("monster_action_queue replays a turn in a fixed order",
+          "[single-file]")
+{
+    // Simulate handle_monsters(): queue every monster, then pop one, spend
+    // some of its energy and requeue it while it can still act, sometimes
+    // queueing another monster in between as effects do. Energies are drawn
+    // from a small range, including negative ones, so that there are plenty
+    // of ties. Every pop must be the highest energy queued, and the earliest
+    // queued of those.
+    const uint64_t seed = GENERATE(1, 2, 3, 20210608);
+    CAPTURE(seed);
+    rng::seed(seed);
+
+    struct entry
+    {
+        monster *mon;
+        int energy;
+        int seq;
+    };
+    vector<entry> expected;
+    int seq = 0;
+
+    monster_action_queue queue;
+    auto push = [&](monster *mon, int energy)
+    {
+        queue.push(mon, energy);
+        expected.push_back({mon, energy, seq++});
+    };
+
+    for (int i = 0; i < MAX_MONSTERS; i++)
+        push(&env.mons[i], random_range(-10, 20) * 10);
+
+    vector<pair<monster*, int>> order;
+    while (!expected.empty())
+    {
+        auto next = min_element(expected.begin(), expected.end(),
+                                [](const entry &a, const entry &b)
+                                {
+                                    return a.energy != b.energy
+                                           ? a.energy > b.energy
+                                           : a.seq < b.seq;
+                                });
+
+        REQUIRE(queue.size() == (int)expected.size());
+        REQUIRE(queue.peek() == make_pair(next->mon, next->energy));
+        const pair<monster*, int> popped = queue.pop();
+        REQUIRE(popped == make_pair(next->mon, next->energy));
+        expected.erase(next);
+        order.push_back(popped);
+
+        const int left = popped.second - random_range(1, 4) * 10;
+        if (left >= 0)
+            push(popped.first, left);
+        if (one_chance_in(20))
+        {
+            monster *mon = &env.mons[random2(MAX_MONSTERS)];
+            push(mon, random_range(-10, 20) * 10);
+        }
+    }
+    REQUIRE(queue.empty());
+    REQUIRE(order.size() > (size_t)MAX_MONSTERS);
+
+    // The same seed gives the same order again, with the queue reused.
+    rng::seed(seed);
+    for (int i = 0; i < MAX_MONSTERS; i++)
+        queue.push(&env.mons[i], random_range(-10, 20) * 10);
+    for (const pair<monster*, int> &popped : order)
+    {
+        REQUIRE(queue.pop() == popped);
+        const int left = popped.second - random_range(1, 4) * 10;
+        if (left >= 0)
+            queue.push(popped.first, left);
+        if (one_chance_in(20))
+        {
+            monster *mon = &env.mons[random2(MAX_MONSTERS)];
+            queue.push(mon, random_range(-10, 20) * 10);
+        }
+    }
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("monster_action_queue can be cleared", "[single-file]")
+{
+    monster_action_queue queue;
+    queue.push(&env.mons[0], 200);
+    queue.push(&env.mons[1], 100);
+    queue.clear();
+    REQUIRE(queue.empty());
+
+    queue.push(&env.mons[2], 90);
+    queue.push(&env.mons[3], -30);
+    REQUIRE(queue.pop().first == &env.mons[2]);
+    REQUIRE(queue.pop().first == &env.mons[3]);
+    REQUIRE(queue.empty());
+}
@@ -4,6 +4,7 @@
 
 #include "AppHdr.h"
 
+#include "env.h"
 #include "map-cell.h"
 #include "random.h"
 #include "tags.h"
@@ -245,3 +246,78 @@ TEST_CASE( "Basic marshalling/unmarshalling works correctly.", "[single-file]" )
         }
     }
 }
+
+TEST_CASE( "Grid planes can be roundtripped", "[single-file]" ) {
+
+    SECTION ("Run-length planes can be roundtripped.") {
+        FixedArray<uint32_t, 17, 11> grid(0);
+        random_device rd;
+        mt19937 generator(rd());
+        uniform_int_distribution<uint32_t> value(0, UINT32_MAX);
+        uniform_int_distribution<int> run(1, 40);
+
+        // Runs of varying length, some crossing column boundaries.
+        int offset = 0;
+        while (offset < grid.size())
+        {
+            const uint32_t v = value(generator);
+            for (int i = run(generator); i && offset < grid.size(); --i)
+            {
+                grid[offset / grid.height()][offset % grid.height()] = v;
+                ++offset;
+            }
+        }
+
+        vector<unsigned char> buf;
+        auto w = writer(&buf);
+        marshallGridRuns(w, grid, [](uint32_t v) { return v; });
+
+        auto r = reader(buf);
+        FixedArray<uint32_t, 17, 11> roundtrip_grid(0);
+        unmarshallGridRuns(r, roundtrip_grid,
+                           [](uint32_t &cell, uint64_t v) { cell = v; });
+
+        for (int x = 0; x < grid.width(); x++)
+            for (int y = 0; y < grid.height(); y++)
+                REQUIRE(grid[x][y] == roundtrip_grid[x][y]);
+        REQUIRE(r.valid() == false);
+    }
+
+    SECTION ("A uniform plane is a single run.") {
+        FixedArray<uint32_t, 17, 11> grid(3);
+
+        vector<unsigned char> buf;
+        auto w = writer(&buf);
+        marshallGridRuns(w, grid, [](uint32_t v) { return v; });
+
+        const vector<unsigned char> expected = {
+            0xBB, 0x01, // run of 187
+            0x03,       // value
+        };
+        REQUIRE(buf == expected);
+    }
+
+    SECTION ("Map knowledge can be roundtripped.") {
+        auto *map = new MapKnowledge();
+        (*map)[0][0].flags = 129;
+        (*map)[5][7].flags = MAP_SEEN_FLAG;
+        (*map)[GXM - 1][GYM - 1].flags = 32769;
+
+        vector<unsigned char> buf;
+        auto w = writer(&buf);
+        marshallMapKnowledge(w, *map);
+
+        auto r = reader(buf);
+        auto *roundtrip_map = new MapKnowledge();
+        (*roundtrip_map)[1][1].flags = 1;
+        unmarshallMapKnowledge(r, *roundtrip_map);
+
+        for (int x = 0; x < GXM; x++)
+            for (int y = 0; y < GYM; y++)
+                REQUIRE((*map)[x][y].flags == (*roundtrip_map)[x][y].flags);
+        REQUIRE(r.valid() == false);
+
+        delete map;
+        delete roundtrip_map;
+    }
+}
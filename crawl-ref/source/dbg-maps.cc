@@ -7,6 +7,12 @@
 
 #include "dbg-maps.h"
 
+#ifdef UNIX
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
@@ -23,6 +29,7 @@
 #include "state.h"
 #include "stringutil.h"
 #include "tag-version.h"
+#include "tags.h"
 #include "view.h"
 
 #ifdef DEBUG_STATISTICS
@@ -47,6 +54,47 @@ static int build_attempts = 0, level_vetoes = 0;
 // Map from message to counts.
 static map<string, int> veto_messages;
 
+// Wall time the builder spent on something, and how much of that was in
+// build attempts that were thrown away.
+struct build_time
+{
+    mapstat_clock::duration total = mapstat_clock::duration::zero();
+    mapstat_clock::duration wasted = mapstat_clock::duration::zero();
+    int runs = 0;
+    int wasted_runs = 0;
+
+    void add(mapstat_clock::duration time, int count, bool waste)
+    {
+        total += time;
+        runs += count;
+        if (waste)
+        {
+            wasted += time;
+            wasted_runs += count;
+        }
+    }
+};
+
+static map<string, build_time> stage_times, vault_times, layout_times;
+static map<level_id, build_time> level_times;
+
+// What the build attempt in progress has spent, until we know whether it
+// was vetoed.
+typedef map<string, pair<mapstat_clock::duration, int>> attempt_times;
+static attempt_times attempt_stages, attempt_vaults;
+static string_set attempt_layouts;
+
+// Set in worker processes of a parallel mapstat run, which must not touch
+// the terminal.
+static bool mapstat_worker = false;
+
+#ifdef UNIX
+// Where a worker sends its statistics to the parent.
+static int mapstat_worker_fd = -1;
+
+static void _send_worker_stats(bool finished, bool success);
+#endif
+
 void mapstat_report_map_build_start()
 {
     build_attempts++;
@@ -60,6 +108,83 @@ void mapstat_report_map_veto(const string &message)
     map_builds[level_id::current()].second++;
 }
 
+static void _charge_attempt(attempt_times &attempt, const string &name,
+                            mapstat_clock::duration time)
+{
+    pair<mapstat_clock::duration, int> &spent =
+        attempt.emplace(name, make_pair(mapstat_clock::duration::zero(), 0))
+            .first->second;
+    spent.first += time;
+    spent.second++;
+}
+
+static void _settle_attempt(attempt_times &attempt,
+                            map<string, build_time> &times, bool waste)
+{
+    for (const auto &entry : attempt)
+        times[entry.first].add(entry.second.first, entry.second.second, waste);
+    attempt.clear();
+}
+
+mapstat_build_timer::mapstat_build_timer()
+    : start(mapstat_clock::now()), success(false)
+{
+    attempt_stages.clear();
+    attempt_vaults.clear();
+    attempt_layouts.clear();
+}
+
+// The layout types are cleared before a successful build returns, so this
+// has to be called while they're still there.
+void mapstat_build_timer::record_layouts()
+{
+    attempt_layouts = env.level_layout_types;
+}
+
+void mapstat_build_timer::succeeded()
+{
+    success = true;
+}
+
+mapstat_build_timer::~mapstat_build_timer()
+{
+    if (!crawl_state.map_stat_gen)
+        return;
+
+    const mapstat_clock::duration time = mapstat_clock::now() - start;
+    if (!env.level_layout_types.empty())
+        record_layouts();
+
+    level_times[level_id::current()].add(time, 1, !success);
+    for (const string &layout : attempt_layouts)
+        layout_times[layout].add(time, 1, !success);
+    _settle_attempt(attempt_stages, stage_times, !success);
+    _settle_attempt(attempt_vaults, vault_times, !success);
+    attempt_layouts.clear();
+}
+
+mapstat_stage_timer::mapstat_stage_timer(const char *_stage)
+    : stage(_stage), start(mapstat_clock::now())
+{
+}
+
+mapstat_stage_timer::~mapstat_stage_timer()
+{
+    if (crawl_state.map_stat_gen)
+        _charge_attempt(attempt_stages, stage, mapstat_clock::now() - start);
+}
+
+mapstat_vault_timer::mapstat_vault_timer(const map_def &map)
+    : name(map.name), start(mapstat_clock::now())
+{
+}
+
+mapstat_vault_timer::~mapstat_vault_timer()
+{
+    if (crawl_state.map_stat_gen)
+        _charge_attempt(attempt_vaults, name, mapstat_clock::now() - start);
+}
+
 static bool _is_disconnected_level()
 {
     // Don't care about non-Dungeon levels.
@@ -74,19 +199,22 @@ static bool _is_disconnected_level()
 
 static bool _do_build_level()
 {
-    clear_messages();
-    mprf("On %s; %d g, %d fail, %u err%s, %u uniq, "
-         "%d try, %d (%.2f%%) vetos",
-         level_id::current().describe().c_str(), levels_tried, levels_failed,
-         (unsigned int)errors.size(), last_error.empty() ? ""
-         : (" (" + last_error + ")").c_str(), (unsigned int) use_count.size(),
-         build_attempts, level_vetoes,
-         build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
+    if (!mapstat_worker)
+    {
+        clear_messages();
+        mprf("On %s; %d g, %d fail, %u err%s, %u uniq, "
+             "%d try, %d (%.2f%%) vetos",
+             level_id::current().describe().c_str(), levels_tried,
+             levels_failed, (unsigned int)errors.size(), last_error.empty()
+             ? "" : (" (" + last_error + ")").c_str(),
+             (unsigned int) use_count.size(), build_attempts, level_vetoes,
+             build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
+    }
 
     watchdog();
 
     msg::suppress mx;
-    if (kbhit() && key_is_escape(getch_ck()))
+    if (!mapstat_worker && kbhit() && key_is_escape(getch_ck()))
     {
         mprf(MSGCH_WARN, "User requested cancel");
         return false;
@@ -226,10 +354,493 @@ static bool _build_dungeon()
 #endif
         if (!_do_build_level())
             return false;
+#ifdef UNIX
+        // Hand over each level as it is built, so that a worker that
+        // crashes only loses the level it was on.
+        if (mapstat_worker)
+            _send_worker_stats(false, true);
+#endif
     }
     return true;
 }
 
+static bool _build_iteration(int i)
+{
+    if (!mapstat_worker)
+    {
+        clear_messages();
+        mprf("On %d of %d; %d g, %d fail, %u err%s, %u uniq, "
+             "%d try, %d (%.2f%%) vetoes",
+             i, SysEnv.map_gen_iters, levels_tried, levels_failed,
+             (unsigned int)errors.size(),
+             last_error.empty() ? "" : (" (" + last_error + ")").c_str(),
+             (unsigned int)use_count.size(), build_attempts, level_vetoes,
+             build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
+    }
+    printf("%d..", i + 1);
+    fflush(stdout);
+    dlua.callfn("dgn_clear_data", "");
+    you.uniq_map_tags.clear();
+    you.uniq_map_names.clear();
+    you.uniq_map_tags_abyss.clear();
+    you.uniq_map_names_abyss.clear();
+    you.unique_creatures.reset();
+    initialise_branch_depths();
+    init_level_connectivity();
+    if (!_build_dungeon())
+        return false;
+    if (crawl_state.obj_stat_gen)
+        objstat_iteration_stats();
+    return true;
+}
+
+#ifdef UNIX
+static void _marshall_counts(writer &outf, const map<string, int> &counts)
+{
+    marshallInt(outf, counts.size());
+    for (const auto &entry : counts)
+    {
+        marshallString(outf, entry.first);
+        marshallInt(outf, entry.second);
+    }
+}
+
+static void _unmarshall_counts(reader &inf, map<string, int> &counts)
+{
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string key = unmarshallString(inf);
+        counts[key] += unmarshallInt(inf);
+    }
+}
+
+static void _marshall_build_time(writer &outf, const build_time &time)
+{
+    marshallSigned(outf, time.total.count());
+    marshallSigned(outf, time.wasted.count());
+    marshallInt(outf, time.runs);
+    marshallInt(outf, time.wasted_runs);
+}
+
+static void _unmarshall_build_time(reader &inf, build_time &time)
+{
+    time.total += mapstat_clock::duration(unmarshallSigned(inf));
+    time.wasted += mapstat_clock::duration(unmarshallSigned(inf));
+    time.runs += unmarshallInt(inf);
+    time.wasted_runs += unmarshallInt(inf);
+}
+
+static void _marshall_build_times(writer &outf,
+                                  const map<string, build_time> &times)
+{
+    marshallInt(outf, times.size());
+    for (const auto &entry : times)
+    {
+        marshallString(outf, entry.first);
+        _marshall_build_time(outf, entry.second);
+    }
+}
+
+static void _unmarshall_build_times(reader &inf,
+                                    map<string, build_time> &times)
+{
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string key = unmarshallString(inf);
+        _unmarshall_build_time(inf, times[key]);
+    }
+}
+
+/**
+ * Send everything a worker process gathered to the parent, for
+ * _merge_worker_stats().
+ */
+static void _marshall_worker_stats(writer &outf, bool success)
+{
+    marshallBoolean(outf, success);
+    marshallInt(outf, levels_tried);
+    marshallInt(outf, levels_failed);
+    marshallInt(outf, build_attempts);
+    marshallInt(outf, level_vetoes);
+    marshallString(outf, last_error);
+
+    _marshall_counts(outf, try_count);
+    _marshall_counts(outf, use_count);
+    _marshall_counts(outf, success_count);
+    _marshall_counts(outf, veto_messages);
+
+    marshallInt(outf, errors.size());
+    for (const auto &entry : errors)
+    {
+        marshallString(outf, entry.first);
+        marshallString(outf, entry.second);
+    }
+
+    marshallInt(outf, level_mapcounts.size());
+    for (const auto &entry : level_mapcounts)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second);
+    }
+
+    marshallInt(outf, map_builds.size());
+    for (const auto &entry : map_builds)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second.first);
+        marshallInt(outf, entry.second.second);
+    }
+
+    marshallInt(outf, level_mapsused.size());
+    for (const auto &entry : level_mapsused)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second.size());
+        for (const string &name : entry.second)
+            marshallString(outf, name);
+    }
+
+    marshallInt(outf, map_levelsused.size());
+    for (const auto &entry : map_levelsused)
+    {
+        marshallString(outf, entry.first);
+        marshallInt(outf, entry.second.size());
+        for (const level_id &lid : entry.second)
+            marshall_level_id(outf, lid);
+    }
+
+    _marshall_build_times(outf, stage_times);
+    _marshall_build_times(outf, vault_times);
+    _marshall_build_times(outf, layout_times);
+    marshallInt(outf, level_times.size());
+    for (const auto &entry : level_times)
+    {
+        marshall_level_id(outf, entry.first);
+        _marshall_build_time(outf, entry.second);
+    }
+}
+
+// Forget the statistics a worker has already sent to the parent.
+static void _clear_worker_stats()
+{
+    levels_tried = levels_failed = 0;
+    build_attempts = level_vetoes = 0;
+    last_error.clear();
+    try_count.clear();
+    use_count.clear();
+    success_count.clear();
+    veto_messages.clear();
+    errors.clear();
+    level_mapcounts.clear();
+    map_builds.clear();
+    level_mapsused.clear();
+    map_levelsused.clear();
+    stage_times.clear();
+    vault_times.clear();
+    layout_times.clear();
+    level_times.clear();
+}
+
+/**
+ * Send the statistics gathered since the last send to the parent, as one
+ * length-prefixed frame, and start counting afresh.
+ *
+ * @param finished Whether this is the worker's last frame.
+ * @param success  Whether the worker built all of its iterations.
+ */
+static void _send_worker_stats(bool finished, bool success)
+{
+    vector<unsigned char> frame(sizeof(uint32_t));
+    {
+        writer w(&frame);
+        marshallBoolean(w, finished);
+        _marshall_worker_stats(w, success);
+    }
+    _clear_worker_stats();
+
+    const uint32_t size = frame.size() - sizeof(uint32_t);
+    memcpy(frame.data(), &size, sizeof(size));
+    for (size_t done = 0; done < frame.size();)
+    {
+        const ssize_t n = write(mapstat_worker_fd, frame.data() + done,
+                                frame.size() - done);
+        if (n == -1 && errno != EINTR)
+            _exit(1);
+        if (n > 0)
+            done += n;
+    }
+}
+
+/**
+ * Add the statistics sent by a worker process to our own.
+ *
+ * @returns Whether the worker built all of its iterations.
+ */
+static bool _merge_worker_stats(reader &inf)
+{
+    const bool success = unmarshallBoolean(inf);
+    levels_tried += unmarshallInt(inf);
+    levels_failed += unmarshallInt(inf);
+    build_attempts += unmarshallInt(inf);
+    level_vetoes += unmarshallInt(inf);
+    const string error = unmarshallString(inf);
+    if (!error.empty())
+        last_error = error;
+
+    _unmarshall_counts(inf, try_count);
+    _unmarshall_counts(inf, use_count);
+    _unmarshall_counts(inf, success_count);
+    _unmarshall_counts(inf, veto_messages);
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string map_name = unmarshallString(inf);
+        errors[map_name] = unmarshallString(inf);
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        level_mapcounts[lid] += unmarshallInt(inf);
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        map_builds[lid].first += unmarshallInt(inf);
+        map_builds[lid].second += unmarshallInt(inf);
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        set<string> &maps = level_mapsused[lid];
+        for (int j = unmarshallInt(inf); j > 0; --j)
+            maps.insert(unmarshallString(inf));
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string map_name = unmarshallString(inf);
+        set<level_id> &levels = map_levelsused[map_name];
+        for (int j = unmarshallInt(inf); j > 0; --j)
+            levels.insert(unmarshall_level_id(inf));
+    }
+
+    _unmarshall_build_times(inf, stage_times);
+    _unmarshall_build_times(inf, vault_times);
+    _unmarshall_build_times(inf, layout_times);
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        _unmarshall_build_time(inf, level_times[lid]);
+    }
+
+    return success;
+}
+
+// A worker process of a parallel mapstat run, as the parent sees it.
+struct mapstat_job
+{
+    pid_t pid;
+    int fd;                        // -1 once the worker has closed its end
+    vector<unsigned char> pending; // what has been read of the next frame
+    bool finished;                 // the worker's last frame has arrived
+    bool success;
+};
+
+/**
+ * Merge every complete frame a worker has sent so far. A frame that can't
+ * be read fails the worker, but the frames after it are still merged.
+ *
+ * @returns False if a frame was corrupt.
+ */
+static bool _merge_worker_frames(mapstat_job &job)
+{
+    bool ok = true;
+    uint32_t size;
+    while (job.pending.size() >= sizeof(size))
+    {
+        memcpy(&size, job.pending.data(), sizeof(size));
+        if (job.pending.size() - sizeof(size) < size)
+            break;
+
+        const auto start = job.pending.begin() + sizeof(size);
+        const vector<unsigned char> frame(start, start + size);
+        job.pending.erase(job.pending.begin(), start + size);
+        try
+        {
+            reader inf(frame, TAG_MINOR_VERSION);
+            inf.set_safe_read(true);
+            const bool finished = unmarshallBoolean(inf);
+            const bool success = _merge_worker_stats(inf);
+            if (finished)
+            {
+                job.finished = true;
+                job.success = success;
+            }
+        }
+        catch (short_read_exception &E)
+        {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Where a worker process leaves its objstat statistics.
+static string _objstat_partial_file(int job)
+{
+    return make_stringf("objstat_partial_%d.bin", job);
+}
+
+/**
+ * Split the mapstat or objstat iterations between SysEnv.map_gen_jobs
+ * worker processes, each with its own copy of the game state and its own
+ * seed. Workers send their mapstat statistics as each level is built, and
+ * we merge them into ours as they arrive; objstat statistics are merged
+ * from each worker's partial file once it has finished.
+ *
+ * @returns True if every worker built all of its iterations.
+ */
+static bool _build_levels_parallel()
+{
+    const int jobs = min(SysEnv.map_gen_jobs, SysEnv.map_gen_iters);
+    vector<mapstat_job> workers;
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int job = 0; job < jobs; ++job)
+    {
+        int fds[2];
+        if (pipe(fds) == -1)
+        {
+            fprintf(stderr, "Couldn't create pipe: %s\n", strerror(errno));
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            fprintf(stderr, "Couldn't fork: %s\n", strerror(errno));
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+
+        if (!pid)
+        {
+            close(fds[0]);
+            for (const mapstat_job &other : workers)
+                close(other.fd);
+            mapstat_worker = true;
+            mapstat_worker_fd = fds[1];
+            rng::seed(crawl_state.seed + job);
+
+            bool success = true;
+            for (int i = job * SysEnv.map_gen_iters / jobs;
+                 success && i < (job + 1) * SysEnv.map_gen_iters / jobs; ++i)
+            {
+                success = _build_iteration(i);
+            }
+            if (success && crawl_state.obj_stat_gen)
+                success = objstat_write_partial(_objstat_partial_file(job));
+
+            _send_worker_stats(true, success);
+            close(fds[1]);
+            fflush(stdout);
+            // Skip exit handlers: the terminal and files belong to the
+            // parent.
+            _exit(0);
+        }
+
+        close(fds[1]);
+        workers.push_back({pid, fds[0], {}, false, false});
+    }
+
+    bool success = (int)workers.size() == jobs;
+    vector<bool> corrupt(workers.size(), false);
+    while (true)
+    {
+        vector<pollfd> polled;
+        vector<unsigned int> polled_job;
+        for (unsigned int i = 0; i < workers.size(); ++i)
+        {
+            if (workers[i].fd == -1)
+                continue;
+            polled.push_back({workers[i].fd, POLLIN, 0});
+            polled_job.push_back(i);
+        }
+        if (polled.empty())
+            break;
+
+        if (poll(polled.data(), polled.size(), -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Couldn't poll workers: %s\n", strerror(errno));
+            for (mapstat_job &job : workers)
+            {
+                if (job.fd != -1)
+                    close(job.fd);
+                job.fd = -1;
+            }
+            break;
+        }
+
+        for (unsigned int p = 0; p < polled.size(); ++p)
+        {
+            if (!polled[p].revents)
+                continue;
+
+            mapstat_job &job = workers[polled_job[p]];
+            unsigned char buf[65536];
+            const ssize_t n = read(job.fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                job.pending.insert(job.pending.end(), buf, buf + n);
+                if (!_merge_worker_frames(job))
+                    corrupt[polled_job[p]] = true;
+            }
+            else if (n == 0 || errno != EINTR)
+            {
+                // Whatever is left of a frame belongs to a level that was
+                // never finished.
+                close(job.fd);
+                job.fd = -1;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < workers.size(); ++i)
+    {
+        bool worker_ok = !corrupt[i] && workers[i].finished
+                         && workers[i].success;
+        int status;
+        if (waitpid(workers[i].pid, &status, 0) == -1
+            || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            worker_ok = false;
+        }
+
+        if (worker_ok && crawl_state.obj_stat_gen)
+        {
+            const string partial = _objstat_partial_file(i);
+            worker_ok = objstat_merge_partial(partial);
+            if (worker_ok)
+                unlink(partial.c_str());
+        }
+
+        if (!worker_ok)
+        {
+            fprintf(stderr, "Worker %u failed.\n", i + 1);
+            success = false;
+        }
+    }
+    return success;
+}
+#endif
+
 /**
  * Build dungeon levels for mapstat or objstat.
  *
@@ -249,31 +860,18 @@ bool mapstat_build_levels()
         _dungeon_places();
     printf("Iteration: ");
     fflush(stdout);
-    for (int i = 0; i < SysEnv.map_gen_iters; ++i)
+#ifdef UNIX
+    if (SysEnv.map_gen_jobs > 1)
     {
-        clear_messages();
-        mprf("On %d of %d; %d g, %d fail, %u err%s, %u uniq, "
-             "%d try, %d (%.2f%%) vetoes",
-             i, SysEnv.map_gen_iters, levels_tried, levels_failed,
-             (unsigned int)errors.size(),
-             last_error.empty() ? "" : (" (" + last_error + ")").c_str(),
-             (unsigned int)use_count.size(), build_attempts, level_vetoes,
-             build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
-        printf("%d..", i + 1);
+        const bool success = _build_levels_parallel();
+        printf("Finished.\n");
         fflush(stdout);
-        dlua.callfn("dgn_clear_data", "");
-        you.uniq_map_tags.clear();
-        you.uniq_map_names.clear();
-        you.uniq_map_tags_abyss.clear();
-        you.uniq_map_names_abyss.clear();
-        you.unique_creatures.reset();
-        initialise_branch_depths();
-        init_level_connectivity();
-        if (!_build_dungeon())
-            return false;
-        if (crawl_state.obj_stat_gen)
-            objstat_iteration_stats();
+        return success;
     }
+#endif
+    for (int i = 0; i < SysEnv.map_gen_iters; ++i)
+        if (!_build_iteration(i))
+            return false;
     printf("Finished.\n");
     fflush(stdout);
     return true;
@@ -331,6 +929,77 @@ static void _check_mapless(const level_id &lid, vector<level_id> &mapless)
         mapless.push_back(lid);
 }
 
+static double _ms(mapstat_clock::duration time)
+{
+    return chrono::duration<double, milli>(time).count();
+}
+
+// List the entries of times, those that lost the most time to vetoes first
+// (or simply the slowest first, if by_waste is false), up to limit entries.
+template <typename K, typename F>
+static void _write_build_times(FILE *outf, const char *title,
+                               const map<K, build_time> &times,
+                               F describe, bool by_waste,
+                               unsigned int limit = 50)
+{
+    vector<pair<K, build_time>> sorted(times.begin(), times.end());
+    sort(sorted.begin(), sorted.end(),
+         [by_waste](const pair<K, build_time> &a,
+                    const pair<K, build_time> &b)
+         {
+             return by_waste ? a.second.wasted > b.second.wasted
+                             : a.second.total > b.second.total;
+         });
+
+    fprintf(outf, "\n\n%s (ms lost to vetoes, ms, vetoed runs, runs, "
+                  "ms per run):\n\n", title);
+    for (unsigned int i = 0; i < sorted.size() && i < limit; ++i)
+    {
+        const build_time &time = sorted[i].second;
+        if (by_waste && time.wasted == mapstat_clock::duration::zero())
+            break;
+
+        fprintf(outf, "%3u) %10.1f, %10.1f, %6d, %6d, %8.3f: %s\n",
+                i + 1, _ms(time.wasted), _ms(time.total), time.wasted_runs,
+                time.runs, time.runs ? _ms(time.total) / time.runs : 0.0,
+                describe(sorted[i].first).c_str());
+    }
+}
+
+static void _write_build_time_stats(FILE *outf)
+{
+    build_time all;
+    for (const auto &entry : level_times)
+    {
+        all.total += entry.second.total;
+        all.wasted += entry.second.wasted;
+        all.runs += entry.second.runs;
+        all.wasted_runs += entry.second.wasted_runs;
+    }
+    if (!all.runs)
+        return;
+
+    fprintf(outf, "\n\nLevel build time: %.1f ms in %d attempts, "
+                  "%.1f ms (%.2f%%) in %d vetoed attempts\n",
+            _ms(all.total), all.runs, _ms(all.wasted),
+            all.total > mapstat_clock::duration::zero()
+                ? _ms(all.wasted) * 100.0 / _ms(all.total) : 0.0,
+            all.wasted_runs);
+
+    auto name = [](const string &s) { return s; };
+    _write_build_times(outf, "Builder stages, including nested stages and "
+                       "maps", stage_times, name, false, stage_times.size());
+    _write_build_times(outf, "Levels by time lost to vetoes", level_times,
+                       [](const level_id &lid) { return lid.describe(); },
+                       true);
+    _write_build_times(outf, "Layout types by time lost to vetoes",
+                       layout_times, name, true);
+    _write_build_times(outf, "Maps by placement time lost to vetoes",
+                       vault_times, name, true);
+    _write_build_times(outf, "Slowest maps to place", vault_times, name,
+                       false);
+}
+
 static void _write_map_stats()
 {
     const char *out_file = "mapstat.log";
@@ -374,6 +1043,7 @@ static void _write_map_stats()
     }
 
     _report_available_random_vaults(outf);
+    mapstat_report_vault_index(outf, generated_levels);
 
     vector<string> unused_maps;
     for (int i = 0, size = map_count(); i < size; ++i)
@@ -417,6 +1087,8 @@ static void _write_map_stats()
             fprintf(outf, "%3d) %s\n", i->first, i->second.c_str());
     }
 
+    _write_build_time_stats(outf);
+
     if (!unused_maps.empty() && !SysEnv.map_gen_range)
     {
         fprintf(outf, "\n\nUnused maps:\n\n");
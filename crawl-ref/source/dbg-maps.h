@@ -7,6 +7,8 @@
 
 #ifdef DEBUG_STATISTICS
 
+#include <chrono>
+
 class map_def;
 void mapstat_report_map_try(const map_def &map);
 void mapstat_report_map_use(const map_def &map);
@@ -17,4 +19,48 @@ void mapstat_report_map_veto(const string &message);
 void mapstat_generate_stats();
 bool mapstat_build_levels();
 bool mapstat_find_forced_map();
+
+typedef chrono::steady_clock mapstat_clock;
+
+// Times one level build attempt for mapstat. The time spent in every stage
+// and vault placement of the attempt is charged as wasted if the attempt
+// doesn't end with succeeded(), whether it was vetoed or threw.
+class mapstat_build_timer
+{
+public:
+    mapstat_build_timer();
+    ~mapstat_build_timer();
+    void record_layouts();
+    void succeeded();
+
+private:
+    mapstat_clock::time_point start;
+    bool success;
+};
+
+// Charges the time until it goes out of scope to a builder stage. Stages
+// may nest, so a stage's time includes the stages and vaults it runs.
+class mapstat_stage_timer
+{
+public:
+    mapstat_stage_timer(const char *stage);
+    ~mapstat_stage_timer();
+
+private:
+    const char *stage;
+    mapstat_clock::time_point start;
+};
+
+// Charges the time until it goes out of scope to one placement attempt of
+// a map, whether or not the map ends up placed.
+class mapstat_vault_timer
+{
+public:
+    mapstat_vault_timer(const map_def &map);
+    ~mapstat_vault_timer();
+
+private:
+    string name;
+    mapstat_clock::time_point start;
+};
 #endif
@@ -38,7 +38,9 @@
 #include "state.h"
 #include "stepdown.h"
 #include "stringutil.h"
+#include "syscalls.h"
 #include "tag-version.h"
+#include "tags.h"
 #include "version.h"
 
 #ifdef DEBUG_STATISTICS
@@ -1042,6 +1044,234 @@ void objstat_iteration_stats()
     }
 }
 
+// Partial statistics from a worker process, for objstat_merge_partial().
+// Only counters that differ from their initial value are written, with
+// field names replaced by indices into a table at the start of the file.
+
+static bool _stat_is_initial(const string &field, int value)
+{
+    if (field == "NumMin")
+        return value == INT_MAX;
+    if (field == "NumMax")
+        return value == -1;
+    return value == 0;
+}
+
+static void _merge_stat(map<string, int> &stats, const string &field,
+                        int value)
+{
+    if (field == "NumMin")
+        stats[field] = min(stats[field], value);
+    else if (field == "NumMax")
+        stats[field] = max(stats[field], value);
+    else
+        stats[field] += value;
+}
+
+static void _marshall_stat_fields(writer &outf, const map<string, int> &stats,
+                                  map<string, int> &field_ids)
+{
+    int count = 0;
+    for (const auto &entry : stats)
+        count += !_stat_is_initial(entry.first, entry.second);
+
+    marshallUByte(outf, count);
+    for (const auto &entry : stats)
+    {
+        if (_stat_is_initial(entry.first, entry.second))
+            continue;
+
+        auto id = field_ids.emplace(entry.first, field_ids.size()).first;
+        marshallUByte(outf, id->second);
+        marshallInt(outf, entry.second);
+    }
+}
+
+static void _unmarshall_stat_fields(reader &inf, map<string, int> &stats,
+                                    const vector<string> &field_names)
+{
+    for (int i = unmarshallUByte(inf); i > 0; --i)
+    {
+        const int id = unmarshallUByte(inf);
+        if (id >= (int)field_names.size())
+            throw short_read_exception();
+        _merge_stat(stats, field_names[id], unmarshallInt(inf));
+    }
+}
+
+// Writes one of the per-level tables keyed by a single type, i.e.
+// monster_recs, feature_recs or spell_recs.
+template<typename T>
+static void _marshall_type_recs(writer &outf,
+                                const map<level_id, map<T, map<string, int>>>
+                                    &recs,
+                                map<string, int> &field_ids)
+{
+    marshallInt(outf, recs.size());
+    for (const auto &lev_entry : recs)
+    {
+        marshall_level_id(outf, lev_entry.first);
+        marshallInt(outf, lev_entry.second.size());
+        for (const auto &entry : lev_entry.second)
+        {
+            marshallShort(outf, entry.first);
+            _marshall_stat_fields(outf, entry.second, field_ids);
+        }
+    }
+}
+
+template<typename T>
+static void _unmarshall_type_recs(reader &inf,
+                                  map<level_id, map<T, map<string, int>>> &recs,
+                                  const vector<string> &field_names)
+{
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        auto &lev_recs = recs[unmarshall_level_id(inf)];
+        for (int j = unmarshallInt(inf); j > 0; --j)
+        {
+            const T type = static_cast<T>(unmarshallShort(inf));
+            _unmarshall_stat_fields(inf, lev_recs[type], field_names);
+        }
+    }
+}
+
+/**
+ * Write the statistics gathered so far by this process to a file, to be
+ * combined with those of other processes by objstat_merge_partial().
+ *
+ * @returns Whether the file was written successfully.
+ */
+bool objstat_write_partial(const string &filename)
+{
+    // Field names are only known once the records have been written.
+    vector<unsigned char> buf;
+    map<string, int> field_ids;
+    {
+        writer outf(&buf);
+
+        marshallInt(outf, item_recs.size());
+        for (const auto &lev_entry : item_recs)
+        {
+            marshall_level_id(outf, lev_entry.first);
+            marshallInt(outf, lev_entry.second.size());
+            for (const auto &base_entry : lev_entry.second)
+            {
+                marshallByte(outf, base_entry.first);
+                marshallInt(outf, base_entry.second.size());
+                for (const auto &sub_entry : base_entry.second)
+                {
+                    marshallShort(outf, sub_entry.first);
+                    _marshall_stat_fields(outf, sub_entry.second, field_ids);
+                }
+            }
+        }
+
+        int num_brands = 0;
+        for (const auto &lev_entry : brand_recs)
+            for (const auto &base_entry : lev_entry.second)
+                for (const auto &sub_entry : base_entry.second)
+                    for (const auto &cat_entry : sub_entry.second)
+                        num_brands += cat_entry.second.size();
+
+        marshallInt(outf, num_brands);
+        for (const auto &lev_entry : brand_recs)
+            for (const auto &base_entry : lev_entry.second)
+                for (const auto &sub_entry : base_entry.second)
+                    for (const auto &cat_entry : sub_entry.second)
+                        for (const auto &brand_entry : cat_entry.second)
+                        {
+                            marshall_level_id(outf, lev_entry.first);
+                            marshallByte(outf, base_entry.first);
+                            marshallShort(outf, sub_entry.first);
+                            marshallByte(outf, cat_entry.first);
+                            marshallShort(outf, brand_entry.first);
+                            marshallInt(outf, brand_entry.second);
+                        }
+
+        _marshall_type_recs(outf, monster_recs, field_ids);
+        _marshall_type_recs(outf, feature_recs, field_ids);
+        _marshall_type_recs(outf, spell_recs, field_ids);
+    }
+    ASSERT(field_ids.size() < 256);
+
+    FILE *fp = fopen_u(filename.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    writer outf(filename, fp, true);
+    vector<string> field_names(field_ids.size());
+    for (const auto &entry : field_ids)
+        field_names[entry.second] = entry.first;
+
+    marshallUByte(outf, field_names.size());
+    for (const string &field : field_names)
+        marshallString(outf, field);
+    outf.write(buf.data(), buf.size());
+
+    const bool ok = outf.succeeded();
+    return fclose(fp) == 0 && ok;
+}
+
+/**
+ * Add the statistics in a file written by objstat_write_partial() to our
+ * own.
+ *
+ * @returns Whether the file could be read in full.
+ */
+bool objstat_merge_partial(const string &filename)
+{
+    reader inf(filename, TAG_MINOR_VERSION);
+    if (!inf.valid())
+        return false;
+
+    try
+    {
+        vector<string> field_names;
+        for (int i = unmarshallUByte(inf); i > 0; --i)
+            field_names.push_back(unmarshallString(inf));
+
+        for (int i = unmarshallInt(inf); i > 0; --i)
+        {
+            auto &lev_recs = item_recs[unmarshall_level_id(inf)];
+            for (int j = unmarshallInt(inf); j > 0; --j)
+            {
+                auto &base_recs =
+                    lev_recs[static_cast<item_base_type>(unmarshallByte(inf))];
+                for (int k = unmarshallInt(inf); k > 0; --k)
+                {
+                    const int sub_type = unmarshallShort(inf);
+                    _unmarshall_stat_fields(inf, base_recs[sub_type],
+                                            field_names);
+                }
+            }
+        }
+
+        for (int i = unmarshallInt(inf); i > 0; --i)
+        {
+            const level_id lev = unmarshall_level_id(inf);
+            const auto base_type = static_cast<item_base_type>(
+                                        unmarshallByte(inf));
+            const int sub_type = unmarshallShort(inf);
+            const auto cat = static_cast<stat_category_type>(
+                                        unmarshallByte(inf));
+            const int brand = unmarshallShort(inf);
+            brand_recs[lev][base_type][sub_type][cat][brand]
+                += unmarshallInt(inf);
+        }
+
+        _unmarshall_type_recs(inf, monster_recs, field_names);
+        _unmarshall_type_recs(inf, feature_recs, field_names);
+        _unmarshall_type_recs(inf, spell_recs, field_names);
+    }
+    catch (short_read_exception &E)
+    {
+        return false;
+    }
+
+    return true;
+}
+
 static FILE * _open_stat_file(string stat_file)
 {
     FILE *stat_fh = nullptr;
@@ -11,4 +11,6 @@ void objstat_generate_stats();
 void objstat_record_monster(const monster *mons);
 void objstat_record_feature(dungeon_feature_type feat_type, bool vault);
 void objstat_iteration_stats();
+bool objstat_write_partial(const string &filename);
+bool objstat_merge_partial(const string &filename);
 #endif
@@ -126,14 +126,24 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, min(sample.changepoint(), changepoint));
 }
 
+pair<double, double> RiverLayout::_warp(const coord_def &p) const
+{
+    const double scalar = 90.0;
+    double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
+    double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
+    return make_pair(x, y);
+}
+
 ProceduralSample
 RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
     const double scale = 10000;
     const double scalar = 90.0;
-    double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
-    double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
-    worley::noise_datum n = worley::noise(x, y, offset / scale + seed);
+    const pair<double, double> warped = cache_warp
+        ? warps.get(p, [this](const coord_def &c) { return _warp(c); })
+        : _warp(p);
+    worley::noise_datum n = worley::noise(warped.first, warped.second,
+                                          offset / scale + seed);
     const uint32_t changepoint = offset + _get_changepoint(n, scale);
     if ((n.id[0] ^ n.id[1] ^ seed) % 4)
         return layout(p, offset);
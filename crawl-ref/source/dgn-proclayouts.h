@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <unordered_map>
 #include <vector>
 
 #include "dungeon.h"
@@ -12,6 +13,7 @@
 #include "fixedvector.h"
 #include "worley.h"
 
+using std::unordered_map;
 using std::vector;
 
 dungeon_feature_type sanitize_feature(dungeon_feature_type feature,
@@ -53,6 +55,50 @@ class ProceduralSamplePQCompare
         }
 };
 
+// Caches a per-cell value that depends only on position, in square tiles of
+// SIZE x SIZE cells. The first lookup in a tile computes the whole tile; the
+// cache is emptied once it holds more than max_tiles tiles.
+template <typename T, int SIZE = 8>
+class ProceduralTileCache
+{
+    public:
+        ProceduralTileCache(size_t _max_tiles = 256) : max_tiles(_max_tiles) { }
+
+        template <typename F>
+        const T &get(const coord_def &p, F compute)
+        {
+            const coord_def tile(_tile_coord(p.x), _tile_coord(p.y));
+            const uint64_t key = (uint64_t)(uint32_t)tile.x << 32
+                                 | (uint32_t)tile.y;
+            auto it = tiles.find(key);
+            if (it == tiles.end())
+            {
+                if (tiles.size() >= max_tiles)
+                    tiles.clear();
+                it = tiles.emplace(key, vector<T>()).first;
+                vector<T> &cells = it->second;
+                cells.reserve(SIZE * SIZE);
+                const coord_def origin = tile * SIZE;
+                for (int y = 0; y < SIZE; ++y)
+                    for (int x = 0; x < SIZE; ++x)
+                        cells.push_back(compute(origin + coord_def(x, y)));
+            }
+            const coord_def local = p - tile * SIZE;
+            return it->second[local.y * SIZE + local.x];
+        }
+
+        void clear() { tiles.clear(); }
+
+    private:
+        static int _tile_coord(int c)
+        {
+            return c >= 0 ? c / SIZE : (c - SIZE + 1) / SIZE;
+        }
+
+        const size_t max_tiles;
+        unordered_map<uint64_t, vector<T>> tiles;
+};
+
 class ProceduralLayout
 {
     public:
@@ -150,13 +196,20 @@ class WastesLayout : public ProceduralLayout
 class RiverLayout : public ProceduralLayout
 {
     public:
-        RiverLayout(uint32_t _seed, const ProceduralLayout &_layout) :
-            seed(_seed), layout(_layout) {}
+        RiverLayout(uint32_t _seed, const ProceduralLayout &_layout,
+                    bool _cache_warp = true) :
+            seed(_seed), layout(_layout), cache_warp(_cache_warp) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
     private:
+        pair<double, double> _warp(const coord_def &p) const;
+
         const uint32_t seed;
         const ProceduralLayout &layout;
+        // The fBM warp of river positions doesn't depend on depth, so keep
+        // it for as long as the area stays around.
+        const bool cache_warp;
+        mutable ProceduralTileCache<pair<double, double>> warps;
 };
 
 // A reimagining of the beloved newabyss layout.
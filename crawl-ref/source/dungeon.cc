@@ -454,6 +454,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
 {
 #ifdef DEBUG_STATISTICS
     mapstat_report_map_build_start();
+    mapstat_build_timer build_timer;
 #endif
 
     dgn_reset_level(enable_random_maps);
@@ -500,6 +501,9 @@ static bool _build_level_vetoable(bool enable_random_maps)
     string level_layout_type = comma_separated_line(
         env.level_layout_types.begin(),
         env.level_layout_types.end(), ", ");
+#ifdef DEBUG_STATISTICS
+    build_timer.record_layouts();
+#endif
 
     // Save information in the level's properties hash table
     // so we can include it in crash reports.
@@ -531,6 +535,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
 #ifdef DEBUG_STATISTICS
     for (auto vault : _you_all_vault_list)
         mapstat_report_map_success(vault);
+    build_timer.succeeded();
 #endif
 
     return true;
@@ -1096,93 +1101,161 @@ static bool _is_exit_stair(const coord_def &c)
 //
 // If fill is non-zero, it fills any disconnected regions with fill.
 //
-// TODO: refactor this to something more usable
-static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
-                bool choose_stairless,
+// Zones are labelled in one pass over the map with a union-find over
+// provisional labels, so passable() is asked once per square rather than
+// once per neighbour of every square flooded. Zone numbers, left in
+// travel_point_distance, are the same as flooding from each zone's first
+// square in row-major order would give.
+static int _process_disconnected_zones(bool choose_stairless,
                 dungeon_feature_type fill,
                 bool (*passable)(const coord_def &) = _dgn_square_is_passable,
                 bool (*fill_check)(const coord_def &) = nullptr,
                 int fill_small_zones = 0)
 {
     memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
-    int ngood = 0;
-    for (int y = y1; y <= y2 ; ++y)
+
+    // Provisional labels; parent[l] == l for a root. Label 0 is unused.
+    vector<int> parent(1, 0);
+    auto find = [&parent](int l)
     {
-        for (int x = x1; x <= x2; ++x)
+        while (parent[l] != l)
         {
-            if (!map_bounds(x, y)
-                || travel_point_distance[x][y]
-                || !passable(coord_def(x, y)))
-            {
+            parent[l] = parent[parent[l]];
+            l = parent[l];
+        }
+        return l;
+    };
+
+    // The neighbours already visited in row-major order.
+    const coord_def earlier[] =
+    {
+        coord_def(-1, 0), coord_def(-1, -1), coord_def(0, -1), coord_def(1, -1)
+    };
+
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
+        {
+            const coord_def c(x, y);
+            if (!map_bounds(c) || !passable(c))
                 continue;
-            }
 
-            int zone_size = 0;
-            auto inc_zone_size = [&zone_size](const coord_def &) { zone_size++; };
-
-            const bool found_exit_stair =
-                _dgn_fill_zone(coord_def(x, y), ++nzones,
-                               inc_zone_size,
-                               passable,
-                               choose_stairless ? (at_branch_bottom() ?
-                                                   _is_upwards_exit_stair :
-                                                   _is_exit_stair) : nullptr);
-
-            // If we want only stairless zones, screen out zones that did
-            // have stairs.
-            if (choose_stairless && found_exit_stair)
-                ++ngood;
-            else if (fill
-                && (fill_small_zones <= 0 || zone_size <= fill_small_zones))
+            int label = 0;
+            for (const coord_def &delta : earlier)
             {
-                // Don't fill in areas connected to vaults.
-                // We want vaults to be accessible; if the area is disconneted
-                // from the rest of the level, this will cause the level to be
-                // vetoed later on.
-                bool veto = false;
-                vector<coord_def> coords;
-                dprf("Filling zone %d", nzones);
-                for (int fy = y1; fy <= y2 ; ++fy)
+                const coord_def n = c + delta;
+                if (!map_bounds(n) || !travel_point_distance[n.x][n.y])
+                    continue;
+
+                const int root = find(travel_point_distance[n.x][n.y]);
+                if (!label)
+                    label = root;
+                else if (root != label)
                 {
-                    for (int fx = x1; fx <= x2; ++fx)
+                    // Keep the older label as the root.
+                    if (root < label)
                     {
-                        if (travel_point_distance[fx][fy] == nzones)
-                        {
-                            if (map_masked(coord_def(fx, fy), MMT_VAULT))
-                            {
-                                veto = true;
-                                break;
-                            }
-                            else if (!fill_check || fill_check(coord_def(fx, fy)))
-                                coords.emplace_back(fx, fy);
-                        }
+                        parent[label] = root;
+                        label = root;
                     }
-                    if (veto)
-                        break;
+                    else
+                        parent[root] = label;
                 }
-                if (!veto)
+            }
+
+            if (!label)
+            {
+                label = parent.size();
+                parent.push_back(label);
+            }
+            travel_point_distance[x][y] = label;
+        }
+
+    // Renumber the zones in order of their first square, and gather what we
+    // need to know about each.
+    vector<int> zone_of(parent.size(), 0);
+    vector<int> zone_size(1, 0);
+    vector<bool> zone_has_exit(1, false);
+    vector<vector<coord_def>> zone_squares(fill ? 1 : 0);
+    bool (*iswanted)(const coord_def &) =
+        choose_stairless ? (at_branch_bottom() ? _is_upwards_exit_stair
+                                               : _is_exit_stair)
+                         : nullptr;
+    int nzones = 0;
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
+        {
+            if (!travel_point_distance[x][y])
+                continue;
+
+            int &zone = zone_of[find(travel_point_distance[x][y])];
+            if (!zone)
+            {
+                zone = ++nzones;
+                zone_size.push_back(0);
+                zone_has_exit.push_back(false);
+                if (fill)
+                    zone_squares.emplace_back();
+            }
+
+            const coord_def c(x, y);
+            travel_point_distance[x][y] = zone;
+            ++zone_size[zone];
+            if (iswanted && !zone_has_exit[zone] && iswanted(c))
+                zone_has_exit[zone] = true;
+            if (fill)
+                zone_squares[zone].push_back(c);
+        }
+
+    int ngood = 0;
+    for (int zone = 1; zone <= nzones; ++zone)
+    {
+        dprf("Zone %d contains %d points", zone, zone_size[zone]);
+
+        // If we want only stairless zones, screen out zones that did
+        // have stairs.
+        if (choose_stairless && zone_has_exit[zone])
+            ++ngood;
+        else if (fill
+            && (fill_small_zones <= 0 || zone_size[zone] <= fill_small_zones))
+        {
+            // Don't fill in areas connected to vaults.
+            // We want vaults to be accessible; if the area is disconneted
+            // from the rest of the level, this will cause the level to be
+            // vetoed later on.
+            bool veto = false;
+            vector<coord_def> coords;
+            dprf("Filling zone %d", zone);
+            for (const coord_def &c : zone_squares[zone])
+            {
+                if (map_masked(c, MMT_VAULT))
+                {
+                    veto = true;
+                    break;
+                }
+                else if (!fill_check || fill_check(c))
+                    coords.push_back(c);
+            }
+            if (!veto)
+            {
+                for (auto c : coords)
                 {
-                    for (auto c : coords)
+                    // For normal builder scenarios items shouldn't be
+                    // placed yet, but it could (if not careful) happen
+                    // in weirder cases, such as the abyss.
+                    if (env.igrid(c) != NON_ITEM
+                        && (!feat_is_traversable(fill)
+                            || feat_destroys_items(fill)))
                     {
-                        // For normal builder scenarios items shouldn't be
-                        // placed yet, but it could (if not careful) happen
-                        // in weirder cases, such as the abyss.
-                        if (env.igrid(c) != NON_ITEM
-                            && (!feat_is_traversable(fill)
-                                || feat_destroys_items(fill)))
-                        {
-                            // Alternatively, could place floor instead?
-                            dprf("Nuke item stack at (%d, %d)", c.x, c.y);
-                            lose_item_stack(c);
-                        }
-                        _set_grd(c, fill);
-                        if (env.mgrid(c) != NON_MONSTER
-                            && !env.mons[env.mgrid(c)].is_habitable_feat(fill))
-                        {
-                            monster_die(env.mons[env.mgrid(c)],
-                                        KILL_RESET, NON_MONSTER, false, true);
-                        }
+                        // Alternatively, could place floor instead?
+                        dprf("Nuke item stack at (%d, %d)", c.x, c.y);
+                        lose_item_stack(c);
+                    }
+                    _set_grd(c, fill);
+                    if (env.mgrid(c) != NON_MONSTER
+                        && !env.mons[env.mgrid(c)].is_habitable_feat(fill))
+                    {
+                        monster_die(env.mons[env.mgrid(c)],
+                                    KILL_RESET, NON_MONSTER, false, true);
                     }
                 }
             }
@@ -1195,8 +1268,8 @@ static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
 int dgn_count_tele_zones(bool choose_stairless)
 {
     dprf("Counting teleport zones");
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                    DNGN_UNSEEN, _dgn_square_is_tele_connected);
+    return _process_disconnected_zones(choose_stairless, DNGN_UNSEEN,
+                                       _dgn_square_is_tele_connected);
 }
 
 // Count number of mutually isolated zones. If choose_stairless, only count
@@ -1205,8 +1278,7 @@ int dgn_count_tele_zones(bool choose_stairless)
 int dgn_count_disconnected_zones(bool choose_stairless,
                                  dungeon_feature_type fill)
 {
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                       fill);
+    return _process_disconnected_zones(choose_stairless, fill);
 }
 
 static void _fill_small_disconnected_zones()
@@ -1214,10 +1286,10 @@ static void _fill_small_disconnected_zones()
     // debugging tip: change the feature to something like lava that will be
     // very noticeable.
     // TODO: make even more agressive, up to ~25?
-    _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_ROCK_WALL,
-                                       _dgn_square_is_passable,
-                                       _dgn_square_is_boring,
-                                       10);
+    _process_disconnected_zones(true, DNGN_ROCK_WALL,
+                                _dgn_square_is_passable,
+                                _dgn_square_is_boring,
+                                10);
 }
 
 static void _fixup_hell_stairs()
@@ -2237,6 +2309,10 @@ static bool _branch_needs_stairs()
 
 static void _dgn_verify_connectivity(unsigned nvaults)
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_dgn_verify_connectivity");
+#endif
+
     // After placing vaults, make sure parts of the level have not been
     // disconnected.
     if (dgn_zones && nvaults != env.level_vaults.size())
@@ -2637,6 +2713,10 @@ static void _place_feature_mimics()
 // regardless of game mode.
 static void _post_vault_build()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_post_vault_build");
+#endif
+
     if (player_in_branch(BRANCH_LAIR))
     {
         int depth = you.depth + 1;
@@ -2946,6 +3026,10 @@ static bool _pan_level()
 // to place more vaults after this
 static bool _builder_by_type()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_builder_by_type");
+#endif
+
     if (player_in_branch(BRANCH_ABYSS))
     {
         generate_abyss();
@@ -3248,6 +3332,10 @@ struct label_match
 // obstructed by slime wall adjacent squares
 static void _slime_connectivity_fixup()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_slime_connectivity_fixup");
+#endif
+
     // Generate a connectivity map considering any non wall, non vault square
     // passable
     FixedArray<int, GXM, GYM> connectivity_map;
@@ -3378,6 +3466,10 @@ static void _slime_connectivity_fixup()
 // Place vaults with CHANCE: that want to be placed on this level.
 static void _place_chance_vaults()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_place_chance_vaults");
+#endif
+
     const level_id &lid(level_id::current());
     mapref_vector maps = random_chance_maps_in_depth(lid);
     // [ds] If there are multiple CHANCE maps that share an luniq_ or
@@ -3415,6 +3507,10 @@ static void _place_chance_vaults()
 
 static void _place_minivaults()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_place_minivaults");
+#endif
+
     const map_def *vault = nullptr;
     // First place the vault requested with &P
     if (you.props.exists(FORCE_MINIVAULT_KEY)
@@ -3725,6 +3821,10 @@ static bool _place_vault_by_tag(const string &tag)
 
 static void _place_branch_entrances(bool use_vaults)
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_place_branch_entrances");
+#endif
+
     // Find what branch entrances are already placed, and what branch
     // entrances could be placed here.
     bool branch_entrance_placed[NUM_BRANCHES];
@@ -3809,6 +3909,10 @@ static void _place_branch_entrances(bool use_vaults)
 
 static void _place_extra_vaults()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_place_extra_vaults");
+#endif
+
     int tries = 0;
     while (true)
     {
@@ -4037,6 +4141,10 @@ bool door_vetoed(const coord_def pos)
 
 static void _builder_monsters()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_builder_monsters");
+#endif
+
     if (player_in_branch(BRANCH_TEMPLE))
         return;
 
@@ -4133,6 +4241,10 @@ static void _randomly_place_item(int item)
  */
 static void _builder_items()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_builder_items");
+#endif
+
     int i = 0;
     object_class_type specif_type = OBJ_RANDOM;
     int items_levels = env.absdepth0;
@@ -4435,6 +4547,9 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     }
 
     unwind_var<string> placing(env.placing_vault, vault->name);
+#ifdef DEBUG_STATISTICS
+    mapstat_vault_timer vault_timer(*vault);
+#endif
 
     vault_placement place;
 
@@ -4529,13 +4644,13 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     if (!build_only && (placed_vault_orientation != MAP_ENCOMPASS || is_layout)
         && player_in_branch(BRANCH_SWAMP))
     {
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_MANGROVE);
+        _process_disconnected_zones(true, DNGN_MANGROVE);
         // do a second pass to remove tele closets consisting of deep water
         // created by the first pass -- which will not fill in deep water
         // because it is treated as impassable.
         // TODO: get zonify to prevent these?
         // TODO: does this come up anywhere outside of swamp?
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_MANGROVE,
+        _process_disconnected_zones(true, DNGN_MANGROVE,
                 _dgn_square_is_ever_passable);
     }
 
@@ -6781,6 +6896,10 @@ void write_level_connectivity(writer &th)
 
 static bool _fixup_interlevel_connectivity()
 {
+#ifdef DEBUG_STATISTICS
+    mapstat_stage_timer stage_timer("_fixup_interlevel_connectivity");
+#endif
+
     // Rotate the stairs on this level to attempt to preserve connectivity
     // as much as possible. At a minimum, it ensures a path from the bottom
     // of a branch to the top of a branch. If this is not possible, it
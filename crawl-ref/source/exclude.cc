@@ -180,14 +180,22 @@ bool travel_exclude::in_bounds(const coord_def &p) const
 
 /////////////////////////////////////////////////////////////////////////
 
+static unsigned int _exclude_generation = 0;
+
 exclude_set::exclude_set()
 {
 }
 
+unsigned int exclude_set::generation()
+{
+    return _exclude_generation;
+}
+
 void exclude_set::clear()
 {
     exclude_roots.clear();
     exclude_points.clear();
+    ++_exclude_generation;
 }
 
 void exclude_set::erase(const coord_def &p)
@@ -219,6 +227,7 @@ void exclude_set::add_exclude(const coord_def &p, int radius,
 
 void exclude_set::add_exclude_points(travel_exclude& ex)
 {
+    ++_exclude_generation;
     if (ex.radius == 0)
     {
         exclude_points.insert(ex.pos);
@@ -251,6 +260,7 @@ void exclude_set::update_excluded_points(bool recompute_los)
 void exclude_set::recompute_excluded_points(bool recompute_los)
 {
     exclude_points.clear();
+    ++_exclude_generation;
     for (iterator it = exclude_roots.begin(); it != exclude_roots.end(); ++it)
     {
         travel_exclude &ex = it->second;
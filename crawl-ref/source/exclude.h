@@ -80,6 +80,9 @@ public:
     size_t size()  const;
     bool   empty() const;
 
+    // Bumped whenever the excluded points of any exclude_set change.
+    static unsigned int generation();
+
     const_iterator begin() const;
     const_iterator end() const;
 
@@ -2426,7 +2426,13 @@ void save_level(const level_id& lid)
     // Nail all items to the ground.
     fix_item_coordinates();
 
-    _write_tagged_chunk(lid.describe(), TAG_LEVEL);
+    // Only marshall the level here; compressing and storing it happens in
+    // the background while the next level loads.
+    vector<unsigned char> buf;
+    writer outf(&buf);
+    write_save_version(outf, save_version::current());
+    tag_write(TAG_LEVEL, outf);
+    you.save->write_async(lid.describe(), move(buf));
 }
 
 #if TAG_MAJOR_VERSION == 34
@@ -2505,6 +2511,23 @@ static void _save_game_exit()
     you.save = 0;
 }
 
+// Long games leave holes behind deleted and rewritten levels; once they
+// are a large enough part of the save, squeeze them out.
+static void _maybe_compact_save()
+{
+    if (!Options.save_compact_slack)
+        return;
+
+    const plen_t size = you.save->get_size();
+    const plen_t slack = you.save->get_slack();
+    if (size && (uint64_t)slack * 100
+                >= (uint64_t)size * Options.save_compact_slack)
+    {
+        dprf("Compacting the save: %u of %u bytes unused.", slack, size);
+        you.save->compact();
+    }
+}
+
 void save_game(bool leave_game, const char *farewellmsg)
 {
     unwind_bool saving_game(crawl_state.saving_game, true);
@@ -2538,6 +2561,7 @@ void save_game(bool leave_game, const char *farewellmsg)
         if (!crawl_state.disables[DIS_SAVE_CHECKPOINTS])
         {
             you.save->commit();
+            _maybe_compact_save();
             save_game_prefs();
         }
         return;
@@ -3071,6 +3095,7 @@ static bool _restore_game(const string& filename)
     clear_message_store();
 
     you.save = new package((_get_savefile_directory() + filename).c_str(), true);
+    you.save->set_compression(Options.save_codec, Options.save_compression);
 
     player_save_info save_info = _read_character_info(you.save);
     if (!save_info.save_loadable)
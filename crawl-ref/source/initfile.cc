@@ -17,6 +17,7 @@
 #include "json-wrapper.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cinttypes>
 #include <cctype>
 #include <cstdio>
@@ -347,6 +348,16 @@ const vector<GameOption*> game_options::build_options_list()
         new IntGameOption(SIMPLE_NAME(level_map_cursor_step), 7, 1, 50),
         new IntGameOption(SIMPLE_NAME(dump_item_origin_price), -1, -1),
         new IntGameOption(SIMPLE_NAME(dump_message_count), 40),
+        new MultipleChoiceGameOption<pkg_codec>(
+            SIMPLE_NAME(save_codec),
+            PKG_CODEC_ZLIB,
+            {{"zlib", PKG_CODEC_ZLIB},
+#ifdef USE_ZSTD
+             {"zstd", PKG_CODEC_ZSTD},
+#endif
+            }),
+        new IntGameOption(SIMPLE_NAME(save_compression), 6, 0, 9),
+        new IntGameOption(SIMPLE_NAME(save_compact_slack), 50, 0, 100),
         new MultipleChoiceGameOption<kill_dump_options>(
             SIMPLE_NAME(dump_kill_places),
             KDO_ONE_PLACE,
@@ -580,6 +591,8 @@ const vector<GameOption*> game_options::build_options_list()
         new StringGameOption(SIMPLE_NAME(fsim_mode), ""),
         new StringGameOption(SIMPLE_NAME(fsim_mons), ""),
         new IntGameOption(SIMPLE_NAME(fsim_rounds), 4000, 1000, 500000),
+        new IntGameOption(SIMPLE_NAME(fsim_precision), 0, 0, 100),
+        new IntGameOption(SIMPLE_NAME(fsim_jobs), 1, 1, 64),
 #endif
 #if !defined(DGAMELAUNCH) || defined(DGL_REMEMBER_NAME)
         new BoolGameOption(SIMPLE_NAME(remember_name), true),
@@ -4312,6 +4325,7 @@ enum commandline_option_type
     CLO_MAPSTAT_DUMP_DISCONNECT,
     CLO_OBJSTAT,
     CLO_ITERATIONS,
+    CLO_JOBS,
     CLO_FORCE_MAP,
     CLO_ARENA,
     CLO_DUMP_MAPS,
@@ -4343,6 +4357,7 @@ enum commandline_option_type
     CLO_SAVE_JSON,
     CLO_GAMETYPES_JSON,
     CLO_EDIT_BONES,
+    CLO_SAVE_STATS,
 #ifdef USE_TILE_WEB
     CLO_WEBTILES_SOCKET,
     CLO_AWAIT_CONNECTION,
@@ -4356,12 +4371,13 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
+    "objstat", "iters", "jobs", "force-map", "arena", "dump-maps", "test", "script",
     "builddb", "help", "version", "seed", "pregen", "save-version", "sprint",
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save",
     "no-player-bones", "gdb", "no-gdb", "nogdb", "throttle", "no-throttle",
     "playable-json", "branches-json", "save-json", "gametypes-json", "bones",
+    "save-stats",
 #ifdef USE_TILE_WEB
     "webtiles-socket", "await-connection", "print-webtiles-options",
 #endif
@@ -4467,6 +4483,8 @@ enum es_command_type
     ES_PUT,
     ES_REPACK,
     ES_INFO,
+    ES_BENCH,
+    ES_COMPACT,
     NUM_ES
 };
 
@@ -4495,6 +4513,8 @@ static edit_command<es_command_type> es_commands[] =
     { ES_RM,      "rm",      true,  1, 1, },
     { ES_REPACK,  "repack",  false, 0, 0, },
     { ES_INFO,    "info",    false, 0, 0, },
+    { ES_BENCH,   "bench",   false, 0, 0, },
+    { ES_COMPACT, "compact", true,  0, 0, },
 };
 
 static edit_command<eb_command_type> eb_commands[] =
@@ -4505,6 +4525,17 @@ static edit_command<eb_command_type> eb_commands[] =
     { EB_REWRITE,  "rewrite", true,  0, 1 },
 };
 
+static const char *_codec_name(pkg_codec codec)
+{
+    switch (codec)
+    {
+    case PKG_CODEC_NONE: return "none";
+    case PKG_CODEC_ZLIB: return "zlib";
+    case PKG_CODEC_ZSTD: return "zstd";
+    default:             return "unknown";
+    }
+}
+
 #define FAIL(...) do { fprintf(stderr, __VA_ARGS__); return; } while (0)
 static void _edit_save(int argc, char **argv)
 {
@@ -4518,6 +4549,9 @@ static void _edit_save(int argc, char **argv)
                "     <chunkfile> defaults to \"chunk\"; use \"-\" for stdout/stdin\n"
                "  rm <chunk>                  delete a chunk\n"
                "  repack                      defrag and reclaim unused space\n"
+               "  compact                     the same, in place\n"
+               "  bench                       time saving and loading the chunks\n"
+               "                              at several compression levels\n"
              );
         return;
     }
@@ -4665,6 +4699,72 @@ static void _edit_save(int argc, char **argv)
             // there's also wasted space due to fragmentation, but since
             // it's linear, there's no need to print it
         }
+        else if (cmd == ES_COMPACT)
+            save.compact();
+        else if (cmd == ES_BENCH)
+        {
+            vector<pair<string, vector<char>>> chunks;
+            double total = 0;
+            for (const string &chunk : save.list_chunks())
+            {
+                chunks.emplace_back(chunk, vector<char>());
+                chunk_reader in(&save, chunk);
+                in.read_all(chunks.back().second);
+                total += chunks.back().second.size();
+            }
+            if (!total)
+                FAIL("The save file is empty.\n");
+
+            const vector<pair<pkg_codec, int>> settings =
+            {
+                { PKG_CODEC_NONE, 0 },
+                { PKG_CODEC_ZLIB, 1 }, { PKG_CODEC_ZLIB, 6 },
+                { PKG_CODEC_ZLIB, 9 },
+#ifdef USE_ZSTD
+                { PKG_CODEC_ZSTD, 1 }, { PKG_CODEC_ZSTD, 3 },
+                { PKG_CODEC_ZSTD, 9 },
+#endif
+            };
+            printf("Codec  Level   Ratio  Save MB/s  Load MB/s\n");
+            for (const auto &setting : settings)
+            {
+                typedef chrono::steady_clock clock;
+                package scratch;
+                scratch.set_compression(setting.first, setting.second);
+
+                const auto save_start = clock::now();
+                for (const auto &chunk : chunks)
+                {
+                    chunk_writer out(&scratch, chunk.first);
+                    if (!chunk.second.empty())
+                        out.write(&chunk.second[0], chunk.second.size());
+                }
+                scratch.commit();
+                const chrono::duration<double> save_time =
+                    clock::now() - save_start;
+
+                const auto load_start = clock::now();
+                for (const auto &chunk : chunks)
+                {
+                    vector<char> data;
+                    chunk_reader in(&scratch, chunk.first);
+                    in.read_all(data);
+                }
+                const chrono::duration<double> load_time =
+                    clock::now() - load_start;
+
+                plen_t packed = 0;
+                for (const auto &chunk : chunks)
+                    packed += scratch.get_chunk_compressed_length(chunk.first);
+
+                const double mb = total / (1024 * 1024);
+                printf("%-5s  %5d  %6.2f  %9.1f  %9.1f\n",
+                       _codec_name(setting.first), setting.second,
+                       total / max<plen_t>(packed, 1),
+                       mb / max(save_time.count(), 1e-6),
+                       mb / max(load_time.count(), 1e-6));
+            }
+        }
     }
     catch (ext_fail_exception &fe)
     {
@@ -4672,6 +4772,44 @@ static void _edit_save(int argc, char **argv)
     }
 }
 
+// Print the layout of each save as tab-separated values: a line for every
+// chunk, then the directory and the unused space of the file.
+static void _save_stats(int argc, char **argv)
+{
+    if (!argc)
+    {
+        printf("Usage: crawl --save-stats <save file>...\n");
+        return;
+    }
+
+    printf("file\tchunk\tcodec\tbytes\tfragments\n");
+    for (int i = 0; i < argc; ++i)
+    {
+        try
+        {
+            package save(argv[i], false);
+            vector<string> list = save.list_chunks();
+            sort(list.begin(), list.end(), numcmpstr);
+            for (const string &chunk : list)
+            {
+                printf("%s\t%s\t%s\t%u\t%u\n", argv[i], chunk.c_str(),
+                       _codec_name(save.get_chunk_codec(chunk)),
+                       save.get_chunk_compressed_length(chunk),
+                       save.get_chunk_fragmentation(chunk));
+            }
+            printf("%s\t(directory)\t%s\t%u\t%u\n", argv[i],
+                   _codec_name(save.get_chunk_codec("")),
+                   save.get_chunk_compressed_length(""),
+                   save.get_chunk_fragmentation(""));
+            printf("%s\t(unused)\t-\t%u\t-\n", argv[i], save.get_slack());
+        }
+        catch (ext_fail_exception &fe)
+        {
+            fprintf(stderr, "Error in %s: %s\n", argv[i], fe.what());
+        }
+    }
+}
+
 static save_version _read_bones_version(const string &filename)
 {
     reader inf(filename);
@@ -5162,6 +5300,7 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
     SysEnv.rcdirs.clear();
     SysEnv.map_gen_iters = 0;
+    SysEnv.map_gen_jobs = 1;
 
     if (argc < 2)           // no args!
         return true;
@@ -5339,6 +5478,20 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_JOBS:
+#ifdef DEBUG_STATISTICS
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.map_gen_jobs = max(atoi(next_arg), 1);
+                nextUsed = true;
+            }
+#else
+            end(1, false, "%s", dbg_stat_err);
+#endif
+            break;
+
         case CLO_FORCE_MAP:
 #ifdef DEBUG_STATISTICS
             if (!next_is_param)
@@ -5543,6 +5696,10 @@ bool parse_args(int argc, char **argv, bool rc_only)
             _edit_bones(argc - current - 1, argv + current + 1);
             end(0);
 
+        case CLO_SAVE_STATS:
+            _save_stats(argc - current - 1, argv + current + 1);
+            end(0);
+
         case CLO_SEED:
             if (!next_is_param)
             {
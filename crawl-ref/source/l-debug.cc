@@ -5,6 +5,8 @@
 
 #include "l-libs.h"
 
+#include <chrono>
+
 #include "act-iter.h"
 #include "branch.h"
 #include "chardump.h"
@@ -22,10 +24,12 @@
 #include "mon-death.h"
 #include "mon-poly.h"
 #include "ng-setup.h"
+#include "package.h"
 #include "religion.h"
 #include "stairs.h"
 #include "state.h"
 #include "stringutil.h"
+#include "tags.h"
 #include "tileview.h"
 #include "unique-creature-list-type.h"
 #include "unwind.h"
@@ -130,6 +134,50 @@ LUAFN(debug_builder_ignore_depth)
     return 0;
 }
 
+// Usage: marshall_level([iterations])
+// Marshalls the current level into a chunk of a scratch save and reads it
+// back in, the given number of times, the way levels are saved and loaded.
+// The chunk is stored uncompressed, so that the time is spent marshalling.
+// Returns the size of the marshalled level in bytes, and the total time
+// taken to write and to read it in milliseconds.
+LUAFN(debug_marshall_level)
+{
+    const int iterations = lua_isnumber(ls, 1) ? luaL_safe_checkint(ls, 1)
+                                               : 1;
+    typedef chrono::steady_clock clock;
+    clock::duration write_time(0), read_time(0);
+    package scratch;
+    scratch.set_compression(PKG_CODEC_NONE, 0);
+    for (int i = 0; i < iterations; ++i)
+    {
+        const clock::time_point start = clock::now();
+        {
+            writer outf(&scratch, "lev");
+            tag_write(TAG_LEVEL, outf);
+        }
+        const clock::time_point written = clock::now();
+        {
+            reader inf(&scratch, "lev", TAG_MINOR_VERSION);
+            tag_read(inf, TAG_LEVEL);
+        }
+        write_time += written - start;
+        read_time += clock::now() - written;
+    }
+
+    vector<char> buf;
+    if (scratch.has_chunk("lev"))
+    {
+        chunk_reader in(&scratch, "lev");
+        in.read_all(buf);
+    }
+    lua_pushnumber(ls, buf.size());
+    lua_pushnumber(ls,
+        chrono::duration_cast<chrono::milliseconds>(write_time).count());
+    lua_pushnumber(ls,
+        chrono::duration_cast<chrono::milliseconds>(read_time).count());
+    return 3;
+}
+
 LUAFN(debug_dump_map)
 {
     const int pos = lua_isuserdata(ls, 1) ? 2 : 1;
@@ -284,6 +332,8 @@ LUAFN(debug_handle_monster_move)
     return 0;
 }
 
+LUAWRAP(debug_handle_monsters, handle_monsters())
+
 static unique_creature_list saved_uniques;
 
 LUAFN(debug_save_uniques)
@@ -558,6 +608,7 @@ const struct luaL_reg debug_dlib[] =
 { "reveal_mimics", debug_reveal_mimics },
 { "los_changed", debug_los_changed },
 { "dump_map", debug_dump_map },
+{ "marshall_level", debug_marshall_level },
 { "vault_names", debug_vault_names },
 { "test_explore", _debug_test_explore },
 { "bouncy_beam", debug_bouncy_beam },
@@ -566,6 +617,7 @@ const struct luaL_reg debug_dlib[] =
 { "dismiss_monsters", debug_dismiss_monsters},
 { "god_wrath", debug_god_wrath},
 { "handle_monster_move", debug_handle_monster_move },
+{ "handle_monsters", debug_handle_monsters },
 { "save_uniques", debug_save_uniques },
 { "randomize_uniques", debug_randomize_uniques },
 { "reset_uniques", debug_reset_uniques },
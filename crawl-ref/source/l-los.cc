@@ -57,11 +57,33 @@ LUAFN(los_cell_see_cell)
     PLUARET(number, cell_see_cell(p, q, LOS_DEFAULT));
 }
 
+// Returns a table of the global LOS cache counters.
+LUAFN(los_get_cache_stats)
+{
+    const los_cache_stats &stats = get_los_cache_stats();
+    lua_newtable(ls);
+    lua_pushnumber(ls, stats.hits);
+    lua_setfield(ls, -2, "hits");
+    lua_pushnumber(ls, stats.misses);
+    lua_setfield(ls, -2, "misses");
+    lua_pushnumber(ls, stats.local_invalidations);
+    lua_setfield(ls, -2, "local_invalidations");
+    lua_pushnumber(ls, stats.full_invalidations);
+    lua_setfield(ls, -2, "full_invalidations");
+    lua_pushnumber(ls, stats.pairs_invalidated);
+    lua_setfield(ls, -2, "pairs_invalidated");
+    return 1;
+}
+
+LUAWRAP(los_reset_cache_stats, reset_los_cache_stats())
+
 const struct luaL_reg los_dlib[] =
 {
     { "findray", los_find_ray },
     { "make_ray", los_make_ray },
     { "cell_see_cell", los_cell_see_cell },
+    { "cache_stats", los_get_cache_stats },
+    { "reset_cache_stats", los_reset_cache_stats },
     { nullptr, nullptr }
 };
 
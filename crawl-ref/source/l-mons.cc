@@ -7,6 +7,7 @@
 
 #include "areas.h"
 #include "cluautil.h"
+#include "coord.h"
 #include "database.h"
 #include "dlua.h"
 #include "items.h"
@@ -14,6 +15,7 @@
 #include "mon-act.h"
 #include "mon-behv.h"
 #include "mon-death.h"
+#include "mon-pathfind.h"
 #include "mon-pick.h"
 #include "mon-speak.h"
 #include "monster.h"
@@ -314,6 +316,23 @@ static int l_mons_do_handle_behaviour(lua_State *ls)
 }
 MDEFN(handle_behaviour, do_handle_behaviour)
 
+// Find a path for the monster to the given position, returning the number
+// of steps in it, or nil if there is none.
+static int l_mons_do_path_to(lua_State *ls)
+{
+    ASSERT_DLUA;
+    monster* mons = clua_get_lightuserdata<monster>(ls, lua_upvalueindex(1));
+    COORDS(dest, 1, 2);
+    if (!mons->alive())
+        return 0;
+
+    monster_pathfind mp;
+    if (!mp.init_pathfind(mons, dest))
+        return 0;
+    PLUARET(number, mp.backtrack().size() - 1);
+}
+MDEFN(path_to, do_path_to)
+
 static int l_mons_do_random_teleport(lua_State *ls)
 {
     // We should only be able to teleport monsters from dlua.
@@ -557,6 +576,7 @@ static MonsAccessor mons_attrs[] =
     { "set_max_hp",      l_mons_set_max_hp      },
     { "run_ai",          l_mons_run_ai          },
     { "handle_behaviour",l_mons_handle_behaviour },
+    { "path_to",         l_mons_path_to         },
     { "experience",      l_mons_experience      },
     { "random_teleport", l_mons_random_teleport },
     { "set_prop",        l_mons_set_prop        },
@@ -85,6 +85,13 @@ static blockrays_t blockrays;
 struct cellray;
 static FixedArray<vector<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> min_cellrays;
 
+// For each target, the cells that lie on at least one minimal cellray
+// to that target, i.e. those cells whose opacity can possibly change
+// whether the target is visible from the origin. Used to invalidate
+// only the affected parts of the global LOS cache.
+typedef FixedArray<bool, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> ray_cells_t;
+static FixedArray<ray_cells_t, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> cellray_cells;
+
 // Temporary arrays used in losight() to track which rays
 // are blocked or have seen a smoke cloud.
 // Allocated when doing the precomputations.
@@ -429,6 +436,14 @@ static void _create_blockrays()
     for (quadrant_iterator qi; qi; ++qi)
         delete all_blockrays(*qi);
 
+    // Record which cells lie on the minimal cellrays to each target.
+    for (quadrant_iterator qi; qi; ++qi)
+        cellray_cells(*qi).init(false);
+    for (quadrant_iterator qi; qi; ++qi)
+        for (int i = 0; i < n_min_rays; ++i)
+            if (blockrays(*qi)->get(i))
+                cellray_cells(cellray_ends[i])(*qi) = true;
+
     dead_rays  = new bit_vector(n_min_rays);
     smoke_rays = new bit_vector(n_min_rays);
 
@@ -542,6 +557,21 @@ void cellray::calc_params()
     first_diag = ((*this)[0].abs() == 2);
 }
 
+// Can the opacity of cell p influence whether target is visible from the
+// origin? Both are given as offsets within the positive quadrant.
+bool cellray_passes_through(const coord_def& target, const coord_def& p)
+{
+    ASSERT(target.x >= 0 && target.y >= 0);
+    ASSERT(p.x >= 0 && p.y >= 0);
+    if (target.rdist() > LOS_MAX_RANGE || p.x > target.x || p.y > target.y)
+        return false;
+
+    // Ensure the precalculations have been done.
+    raycast();
+
+    return cellray_cells(target)(p);
+}
+
 // Find ray in positive quadrant.
 // opc has been translated for this quadrant.
 // XXX: Allow finding ray of minimum opacity.
@@ -754,7 +784,7 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
             break;
         case OPC_HALF:
             // Block rays which have already seen a cloud.
-            *dead_rays  |= (*smoke_rays & *blockrays(*qi));
+            dead_rays->or_and(*smoke_rays, *blockrays(*qi));
             *smoke_rays |= *blockrays(*qi);
             break;
         default:
@@ -763,18 +793,17 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
     }
 
     // Ray calculation done. Now work out which cells in this
-    // quadrant are visible.
-    for (unsigned int rayidx = 0; rayidx < num_cellrays; ++rayidx)
+    // quadrant are visible, skipping over the dead rays a word
+    // at a time.
+    for (unsigned int rayidx = dead_rays->next_unset(0);
+         rayidx < num_cellrays;
+         rayidx = dead_rays->next_unset(rayidx + 1))
     {
-        // make the cells seen by this ray at this point visible
-        if (!dead_rays->get(rayidx))
-        {
-            // This ray is alive, thus the end cell is visible.
-            const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
-                                          sy * cellray_ends[rayidx].y);
-            if (dat.los_bounds(p))
-                sh(p) = true;
-        }
+        // This ray is alive, thus the end cell is visible.
+        const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
+                                      sy * cellray_ends[rayidx].y);
+        if (dat.los_bounds(p))
+            sh(p) = true;
     }
 }
 
@@ -33,6 +33,7 @@ void fallback_ray(const coord_def& source, const coord_def& target,
                   ray_def& ray);
 
 bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2);
+bool cellray_passes_through(const coord_def& target, const coord_def& p);
 
 typedef SquareArray<bool, LOS_MAX_RANGE> los_grid;
 
@@ -6,16 +6,64 @@
 #include "coordit.h"
 #include "libutil.h"
 #include "los-def.h"
+#include "los.h"
 
 #define LOS_KNOWN 4
 
+// Each field packs two bits per los_type: whether the value is known, and
+// whether the pair of cells can see each other.
 typedef uint8_t losfield_t;
 typedef losfield_t halflos_t[LOS_MAX_RANGE+1][2*LOS_MAX_RANGE+1];
 static const int o_half_x = 0;
 static const int o_half_y = LOS_MAX_RANGE;
-typedef halflos_t globallos_t[GXM][GYM];
 
-static globallos_t globallos;
+// The cache is split into tiles of LOS_TILE x LOS_TILE source cells, which
+// are only allocated once a cell in them is looked up. A tile is valid
+// only if its generation matches los_generation, so invalidating the
+// whole cache is just a counter increment; stale tiles are cleared when
+// they are next used.
+#define LOS_TILE 8
+#define LOS_TILES_X ((GXM + LOS_TILE - 1) / LOS_TILE)
+#define LOS_TILES_Y ((GYM + LOS_TILE - 1) / LOS_TILE)
+
+struct los_tile
+{
+    unsigned int generation;
+    halflos_t cells[LOS_TILE][LOS_TILE];
+};
+
+static unique_ptr<los_tile> globallos[LOS_TILES_X][LOS_TILES_Y];
+static unsigned int los_generation = 1;
+
+static los_cache_stats cache_stats;
+
+// The cached block of pairs with lesser cell p, or nullptr if nothing
+// is cached for it.
+static halflos_t* _cached_halflos(const coord_def& p)
+{
+    los_tile* tile = globallos[p.x / LOS_TILE][p.y / LOS_TILE].get();
+    if (!tile || tile->generation != los_generation)
+        return nullptr;
+    return &tile->cells[p.x % LOS_TILE][p.y % LOS_TILE];
+}
+
+// The block of pairs with lesser cell p, allocating or clearing its
+// tile if necessary.
+static halflos_t& _halflos_at(const coord_def& p)
+{
+    unique_ptr<los_tile>& tile = globallos[p.x / LOS_TILE][p.y / LOS_TILE];
+    if (!tile)
+    {
+        tile.reset(new los_tile);
+        tile->generation = 0;
+    }
+    if (tile->generation != los_generation)
+    {
+        memset(tile->cells, 0, sizeof(tile->cells));
+        tile->generation = los_generation;
+    }
+    return tile->cells[p.x % LOS_TILE][p.y % LOS_TILE];
+}
 
 static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
 {
@@ -28,9 +76,9 @@ static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
         return nullptr;
     // p < q iff p.x < q.x || p.x == q.x && p.y < q.y
     if (diff < coord_def(0, 0))
-        return &globallos[q.x][q.y][-diff.x + o_half_x][-diff.y + o_half_y];
+        return &_halflos_at(q)[-diff.x + o_half_x][-diff.y + o_half_y];
     else
-        return &globallos[p.x][p.y][ diff.x + o_half_x][ diff.y + o_half_y];
+        return &_halflos_at(p)[ diff.x + o_half_x][ diff.y + o_half_y];
 }
 
 static void _save_los(los_def* los, los_type l)
@@ -58,22 +106,68 @@ static void _save_los(los_def* los, los_type l)
         }
 }
 
+static coord_def _quadrant_abs(const coord_def& c)
+{
+    return coord_def(abs(c.x), abs(c.y));
+}
+
+// Could the opacity at a + r change whether a and a + d see each other?
+// The pair may have been computed from either end, so check both.
+static bool _pair_depends_on(const coord_def& d, const coord_def& r)
+{
+    const coord_def target = _quadrant_abs(d);
+    return cellray_passes_through(target, _quadrant_abs(r))
+           || cellray_passes_through(target, _quadrant_abs(r - d));
+}
+
 // Opacity at p has changed.
+// Only the cached pairs whose cellrays pass through p are cleared; the
+// rest of each halflos_t block stays valid.
 void invalidate_los_around(const coord_def& p)
 {
+    cache_stats.local_invalidations++;
     int x1 = max(p.x - LOS_MAX_RANGE, 0);
     int y1 = max(p.y - LOS_MAX_RANGE, 0);
     int x2 = min(p.x, GXM - 1);
     int y2 = min(p.y + LOS_MAX_RANGE, GYM - 1);
     for (int y = y1; y <= y2; y++)
         for (int x = x1; x <= x2; x++)
-            memset(globallos[x][y], 0, sizeof(halflos_t));
+        {
+            halflos_t* half = _cached_halflos(coord_def(x, y));
+            if (!half)
+                continue;
+
+            // p relative to the lesser cell of each stored pair.
+            const coord_def r = p - coord_def(x, y);
+            for (int dx = r.x; dx <= LOS_MAX_RANGE; dx++)
+            {
+                // p has to lie within the bounding box of the pair.
+                const int dy1 = r.y > 0 ? r.y : -LOS_MAX_RANGE;
+                const int dy2 = r.y < 0 ? r.y : LOS_MAX_RANGE;
+                for (int dy = dy1; dy <= dy2; dy++)
+                {
+                    losfield_t &flags = (*half)[dx + o_half_x][dy + o_half_y];
+                    if (flags && _pair_depends_on(coord_def(dx, dy), r))
+                    {
+                        flags = 0;
+                        cache_stats.pairs_invalidated++;
+                    }
+                }
+            }
+        }
 }
 
 void invalidate_los()
 {
-    for (rectangle_iterator ri(0); ri; ++ri)
-        memset(globallos[ri->x][ri->y], 0, sizeof(halflos_t));
+    cache_stats.full_invalidations++;
+    if (++los_generation == 0)
+    {
+        // The counter wrapped around; make sure no stale tile can match.
+        for (int x = 0; x < LOS_TILES_X; x++)
+            for (int y = 0; y < LOS_TILES_Y; y++)
+                globallos[x][y].reset();
+        los_generation = 1;
+    }
 }
 
 static void _update_globallos_at(const coord_def& p, los_type l)
@@ -123,9 +217,24 @@ bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l)
     if (!flags)
         return false; // outside range
 
-    if (!(*flags & (l << LOS_KNOWN)))
+    if (*flags & (l << LOS_KNOWN))
+        cache_stats.hits++;
+    else
+    {
+        cache_stats.misses++;
         _update_globallos_at(p, l);
+    }
 
     ASSERT(*flags & (l << LOS_KNOWN));
     return *flags & l;
 }
+
+const los_cache_stats& get_los_cache_stats()
+{
+    return cache_stats;
+}
+
+void reset_los_cache_stats()
+{
+    cache_stats = los_cache_stats();
+}
@@ -6,3 +6,15 @@ void invalidate_los_around(const coord_def& p);
 void invalidate_los();
 
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l);
+
+struct los_cache_stats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t local_invalidations = 0;
+    uint64_t full_invalidations = 0;
+    uint64_t pairs_invalidated = 0;
+};
+
+const los_cache_stats& get_los_cache_stats();
+void reset_los_cache_stats();
@@ -536,6 +536,8 @@ static void _show_commandline_options_help()
     puts("");
     puts("Arena options: (Stage a tournament between various monsters.)");
     puts("  -arena \"<monster list> v <monster list> arena:<arena map>\"");
+    puts("  -arena \"headless results:csv t:1000 <monster list> v <monster list>\"");
+    puts("                         run without display, one CSV line per round");
 #ifdef DEBUG_DIAGNOSTICS
     puts("");
     puts("Diagnostic options:");
@@ -561,6 +563,9 @@ static void _show_commandline_options_help()
     puts("      Defaults to entire dungeon; same level syntax as -mapstat.");
     puts("  -iters <num>        For -mapstat and -objstat, set the number of "
          "iterations");
+    puts("  -jobs <num>         For -mapstat and -objstat, split the "
+         "iterations between");
+    puts("      <num> processes");
     puts("  -force-map <map>    For -mapstat and -objstat, alway choose the "
          "      given map on every level.");
 #endif
@@ -573,6 +578,7 @@ static void _show_commandline_options_help()
     puts("  -playable-json   list playable species, jobs, and character combos.");
     puts("  -branches-json   list branch data.");
     puts("  -no-player-bones do not write player's info to bones files.");
+    puts("  -save-stats <file>... list the chunks and unused space of save files.");
 
 #if defined(TARGET_OS_WINDOWS) && defined(USE_TILE_LOCAL)
     text_popup(help, L"Dungeon Crawl command line help");
@@ -2532,8 +2538,11 @@ void world_reacts()
     {
         crawl_state.viewport_monster_hp = false;
         crawl_state.viewport_weapons = false;
-        viewwindow();
-        update_screen();
+        if (!crawl_state.arena_headless)
+        {
+            viewwindow();
+            update_screen();
+        }
     }
 
     // prevent monsters wandering into view and picking up an item before
@@ -2612,8 +2621,11 @@ void world_reacts()
 
     add_auto_excludes();
 
-    viewwindow();
-    update_screen();
+    if (!crawl_state.arena_headless)
+    {
+        viewwindow();
+        update_screen();
+    }
 
     if (you.cannot_act() && any_messages()
         && crawl_state.repeat_cmd != CMD_WIZARD)
@@ -12,7 +12,9 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <unordered_map>
 
 #include "abyss.h"
 #include "artefact.h"
@@ -80,6 +82,130 @@ void tag_profile_out()
 }
 #endif
 
+///////////////////////////////////////////////
+// Map tags
+//
+
+struct map_tag_table
+{
+    unordered_map<string, int> ids;
+    // A deque so that map_tag_name() references stay valid as tags are added.
+    deque<string> names;
+};
+
+// Function-local so that map_tag handles can be initialised statically.
+static map_tag_table &_map_tags()
+{
+    static map_tag_table table;
+    return table;
+}
+
+int map_tag_id(const string &tag)
+{
+    map_tag_table &table = _map_tags();
+    auto id = table.ids.emplace(tag, table.names.size());
+    if (id.second)
+        table.names.push_back(tag);
+    return id.first->second;
+}
+
+int find_map_tag_id(const string &tag)
+{
+    const map_tag_table &table = _map_tags();
+    auto id = table.ids.find(tag);
+    return id == table.ids.end() ? -1 : id->second;
+}
+
+const string &map_tag_name(int id)
+{
+    return _map_tags().names[id];
+}
+
+int map_tag_count()
+{
+    return _map_tags().names.size();
+}
+
+bool map_tag_set::empty() const
+{
+    for (uint64_t word : bits)
+        if (word)
+            return false;
+    return true;
+}
+
+void map_tag_set::add(int id)
+{
+    ASSERT(id >= 0);
+    const unsigned w = id / 64;
+    if (w >= bits.size())
+        bits.resize(w + 1, 0);
+    bits[w] |= UINT64_C(1) << (id % 64);
+}
+
+bool map_tag_set::remove(int id)
+{
+    if (!has(id))
+        return false;
+    bits[id / 64] &= ~(UINT64_C(1) << (id % 64));
+    return true;
+}
+
+bool map_tag_set::intersects(const map_tag_set &other) const
+{
+    for (unsigned w = 0, size = min(bits.size(), other.bits.size()); w < size;
+         ++w)
+    {
+        if (bits[w] & other.bits[w])
+            return true;
+    }
+    return false;
+}
+
+int map_tag_set::next(int start) const
+{
+    for (unsigned w = start / 64; w < bits.size(); ++w)
+    {
+        uint64_t word = bits[w];
+        if (w == (unsigned) start / 64)
+            word &= ~UINT64_C(0) << (start % 64);
+        for (int b = 0; word; ++b, word >>= 1)
+            if (word & 1)
+                return w * 64 + b;
+    }
+    return -1;
+}
+
+map_tag_class::map_tag_class(const string &_affix, bool _suffix)
+    : affix(_affix), suffix(_suffix), matches(), checked(0)
+{
+}
+
+const map_tag_set &map_tag_class::tags() const
+{
+    for (const int count = map_tag_count(); checked < count; ++checked)
+    {
+        const string &tag = map_tag_name(checked);
+        if (!affix.empty()
+            && (suffix ? ends_with(tag, affix) : starts_with(tag, affix)))
+        {
+            matches.add(checked);
+        }
+    }
+    return matches;
+}
+
+// Classes for the prefixes and suffixes asked about by name.
+static const map_tag_class &_map_tag_class(const string &affix, bool suffix)
+{
+    static unordered_map<string, map_tag_class> classes[2];
+    auto &known = classes[suffix];
+    auto cls = known.find(affix);
+    if (cls == known.end())
+        cls = known.emplace(affix, map_tag_class(affix, suffix)).first;
+    return cls->second;
+}
+
 static const char *map_section_names[] =
 {
     "",
@@ -2386,8 +2512,9 @@ void map_def::read_full(reader& inf)
 {
     // There's a potential race-condition here:
     // - If someone modifies a .des file while there are games in progress,
-    // - a new Crawl process will overwrite the .dsc.
-    // - older Crawl processes trying to reading the new .dsc will be hosed.
+    // - a new Crawl process will replace the vault pack.
+    // - older Crawl processes keep the pack they opened, but a body that
+    //   fails the version check below can't be used.
     // We could try to recover from the condition (by locking and
     // reloading the index), but it's easier to save the game at this
     // point and let the player reload.
@@ -2468,18 +2595,26 @@ void map_def::load()
     if (!index_only)
         return;
 
-    const string descache_base = get_descache_path(cache_name, "");
-    file_lock deslock(descache_base + ".lk", "rb", false);
-    const string loadfile = descache_base + ".dsc";
-
-    reader inf(loadfile, TAG_MINOR_VERSION);
-    if (!inf.valid())
+    size_t size;
+    int minor;
+    const unsigned char *pack = vault_pack_data(size, minor);
+    if (!pack || cache_offset <= 0 || (size_t) cache_offset >= size)
     {
         throw map_load_exception(
                 make_stringf("Map inf is invalid: %s", name.c_str()));
     }
-    inf.advance(cache_offset);
-    read_full(inf);
+
+    reader inf(pack + cache_offset, size - cache_offset, minor);
+    inf.set_safe_read(true);
+    try
+    {
+        read_full(inf);
+    }
+    catch (short_read_exception &E)
+    {
+        throw map_load_exception(
+                make_stringf("Map body is truncated: %s", name.c_str()));
+    }
 
     index_only = false;
 }
@@ -2574,7 +2709,6 @@ void map_def::set_file(const string &s)
     veto.set_file(s);
     epilogue.set_file(s);
     file = get_base_filename(s);
-    cache_name = get_cache_name(s);
 }
 
 string map_def::run_lua(bool run_main)
@@ -2794,9 +2928,9 @@ string map_def::validate_map_placeable()
     // Ok, the map wants to be placed by tag. In this case it should have
     // at least one tag that's not a map flag.
     bool has_selectable_tag = false;
-    for (const string &piece : tags)
+    for (int id = tags.next(0); id >= 0; id = tags.next(id + 1))
     {
-        if (_map_tag_is_selectable(piece))
+        if (_map_tag_is_selectable(map_tag_name(id)))
         {
             has_selectable_tag = true;
             break;
@@ -3341,56 +3475,54 @@ bool map_def::has_tag(const string &tagwanted) const
 #ifdef DEBUG_TAG_PROFILING
     _profile_inc_tag(tagwanted);
 #endif
-    return tags.count(tagwanted) > 0;
+    return tags.has(find_map_tag_id(tagwanted));
 }
 
 bool map_def::has_tag_prefix(const string &prefix) const
 {
     if (prefix.empty())
         return false;
-    for (const auto &tag : tags)
-        if (starts_with(tag, prefix))
-            return true;
-    return false;
+    return has_tag_in(_map_tag_class(prefix, false));
 }
 
 bool map_def::has_tag_suffix(const string &suffix) const
 {
     if (suffix.empty())
         return false;
-    for (const auto &tag : tags)
-        if (ends_with(tag, suffix))
-            return true;
-    return false;
+    return has_tag_in(_map_tag_class(suffix, true));
 }
 
 const unordered_set<string> map_def::get_tags_unsorted() const
 {
-    return tags;
+    unordered_set<string> result;
+    for (int id = tags.next(0); id >= 0; id = tags.next(id + 1))
+        result.insert(map_tag_name(id));
+    return result;
 }
 
 const vector<string> map_def::get_tags() const
 {
     // this might seem inefficient, but get_tags is not called very much; the
     // hotspot revealed by profiling is actually has_tag checks.
-    vector<string> result(tags.begin(), tags.end());
+    vector<string> result;
+    for (int id = tags.next(0); id >= 0; id = tags.next(id + 1))
+        result.push_back(map_tag_name(id));
     sort(result.begin(), result.end());
     return result;
 }
 
 void map_def::add_tags(const string &tag)
 {
-    auto parsed_tags = parse_tags(tag);
-    tags.insert(parsed_tags.begin(), parsed_tags.end());
+    for (const string &t : parse_tags(tag))
+        tags.add(map_tag_id(t));
     update_cached_tags();
 }
 
 bool map_def::remove_tags(const string &tag)
 {
     bool removed = false;
-    auto parsed_tags = parse_tags(tag);
-    for (auto &t : parsed_tags)
-        removed = tags.erase(t) || removed; // would iterator overload be ok?
+    for (const string &t : parse_tags(tag))
+        removed = tags.remove(find_map_tag_id(t)) || removed;
     update_cached_tags();
     return removed;
 }
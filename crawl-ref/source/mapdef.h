@@ -54,8 +54,8 @@ static const int INVALID_HEIGHT = -31999;
 
 static const int BRANCH_END = 100;
 
-// Exception thrown when a map cannot be loaded from its .dsc file
-// because the .dsc file has changed under it.
+// Exception thrown when a map cannot be loaded from the vault pack
+// because the pack has changed under it.
 struct map_load_exception : public runtime_error
 {
     // g++ 4.7 doesn't have inherited constructors, sadly
@@ -1085,6 +1085,58 @@ struct subvault_place
     void set_subvault(const map_def &);
 };
 
+/////////////////////////////////////////////////////////////////////////////
+// Map tags are interned: each distinct tag gets a small id, and a map's tags
+// are a bitset of those ids.
+int map_tag_id(const string &tag);
+// The id of a tag, or -1 if it has never been interned.
+int find_map_tag_id(const string &tag);
+const string &map_tag_name(int id);
+int map_tag_count();
+
+class map_tag_set
+{
+public:
+    bool empty() const;
+    bool has(int id) const
+    {
+        const unsigned w = id / 64;
+        return id >= 0 && w < bits.size() && (bits[w] >> (id % 64) & 1);
+    }
+    void add(int id);
+    bool remove(int id);
+    void clear() { bits.clear(); }
+    bool intersects(const map_tag_set &other) const;
+    // The first id >= start in the set, or -1 if none.
+    int next(int start) const;
+
+private:
+    vector<uint64_t> bits;
+};
+
+// A tag interned ahead of time, so that hot loops can test for it without
+// hashing its name.
+struct map_tag
+{
+    explicit map_tag(const string &name) : id(map_tag_id(name)) { }
+    const int id;
+};
+
+// All tags starting (or ending) with the given affix. Tags interned later
+// are picked up the next time the set is used.
+class map_tag_class
+{
+public:
+    map_tag_class(const string &affix, bool suffix = false);
+    const map_tag_set &tags() const;
+
+private:
+    string affix;
+    bool suffix;
+    mutable map_tag_set matches;
+    mutable int checked;
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // map_def: map definitions for maps loaded from .des files.
 //
@@ -1156,11 +1208,11 @@ public:
     string          file;
 
 private:
-    unordered_set<string>     tags;
+    // The ids of the map's tags; see map_tag_id().
+    map_tag_set     tags;
     // This map has been loaded from an index, and not fully realised.
     bool            index_only;
-    mutable long    cache_offset;
-    string          cache_name;
+    mutable long    cache_offset; // of the map body in the vault pack
 
     typedef Matrix<bool> subvault_mask;
     subvault_mask *svmask;
@@ -1211,6 +1263,7 @@ public:
     void read_maplines(reader&);
 
     void set_file(const string &s);
+    void set_cache_offset(long offset) { cache_offset = offset; }
     string run_lua(bool skip_main);
     bool run_hook(const string &hook_name, bool die_on_lua_error = false);
     bool run_postplace_hook(bool die_on_lua_error = false);
@@ -1262,8 +1315,16 @@ public:
     bool is_overwritable_layout() const;
     bool is_extra_vault() const;
     bool has_tag(const string &tagwanted) const;
+    bool has_tag(const map_tag &tagwanted) const
+    {
+        return tags.has(tagwanted.id);
+    }
     bool has_tag_prefix(const string &tag) const;
     bool has_tag_suffix(const string &suffix) const;
+    bool has_tag_in(const map_tag_class &tagclass) const
+    {
+        return tags.intersects(tagclass.tags());
+    }
 
     template <typename TagIterator>
     bool has_all_tags(TagIterator begin, TagIterator end) const
@@ -1288,6 +1349,7 @@ public:
 
     const vector<string> get_tags() const;
     const unordered_set<string> get_tags_unsorted() const;
+    const map_tag_set &get_tag_ids() const { return tags; }
     void add_tags(const string &tag);
     void set_tags(const string &tag);
     bool remove_tags(const string &tag);
@@ -8,14 +8,23 @@
 #include "maps.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <tuple>
+#include <unordered_map>
+#include <fcntl.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
 #endif
+#ifdef UNIX
+#include <sys/mman.h>
+#endif
 
+#include "bitary.h"
 #include "branch.h"
 #include "coord.h"
 #include "coordit.h"
@@ -26,6 +35,7 @@
 #include "files.h"
 #include "mapmark.h"
 #include "message.h"
+#include "place.h"
 #include "state.h"
 #include "stringutil.h"
 #include "syscalls.h"
@@ -705,12 +715,24 @@ static map_section_type _apply_vault_definition(
 ///////////////////////////////////////////////////////////////////////////
 // Map lookups
 
+// Tags checked for every candidate map, interned up front.
+static const map_tag dummy_tag("dummy");
+static const map_tag unrand_tag("unrand");
+static const map_tag place_unique_tag("place_unique");
+static const map_tag tutorial_tag("tutorial");
+static const map_tag_class entry_tags("entry", true);
+static const map_tag_class layout_tags("layout_");
+static const map_tag_class nolayout_tags("nolayout_");
+static const map_tag_class temple_tags("temple_");
+static const map_tag_class tutorial_tags("tutorial");
+static const map_tag_class uniq_altar_tags("uniq_altar_");
+
 static bool _map_matches_layout_type(const map_def &map)
 {
     bool permissive = false;
     if (env.level_layout_types.empty()
-        || (!map.has_tag_prefix("layout_")
-            && !(permissive = map.has_tag_prefix("nolayout_"))))
+        || (!map.has_tag_in(layout_tags)
+            && !(permissive = map.has_tag_in(nolayout_tags))))
     {
         return true;
     }
@@ -730,8 +752,133 @@ static bool _map_matches_species(const map_def &map)
 {
     if (!species::is_valid(you.species))
         return true;
-    return !map.has_tag("no_species_"
-           + lowercase_string(species::get_abbrev(you.species)));
+
+    static species_type tag_species = SP_UNKNOWN;
+    static int tag_id = -1;
+    if (tag_species != you.species)
+    {
+        tag_species = you.species;
+        tag_id = map_tag_id("no_species_"
+                    + lowercase_string(species::get_abbrev(you.species)));
+    }
+    return !map.get_tag_ids().has(tag_id);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Vault index
+//
+// Selecting a map used to test every map in vdefs. The index narrows that
+// down to the maps that could possibly match, as bits indexed by position in
+// vdefs: for each tag the maps that have it, and for each level the maps
+// whose DEPTH or PLACE allow them there. Candidates are still checked in
+// full, so the index only ever has to be a superset of the real matches.
+
+// Everything level_range::matches() depends on, since branch entry depths
+// and lengths differ between games.
+typedef tuple<int, int, int, int> vault_level_key;
+
+struct vault_index
+{
+    vault_index() : built(false) { }
+
+    bool built;
+    // By interned tag id.
+    vector<bit_vector> tag_maps;
+    // Maps with no DEPTH, which tag lookups may accept anywhere.
+    bit_vector no_depth;
+    map<vault_level_key, bit_vector> depth_maps;
+    map<vault_level_key, bit_vector> place_maps;
+};
+
+static vault_index vindex;
+
+// Must be called whenever vdefs or the tags of its maps change.
+static void _vault_index_changed()
+{
+    vindex.built = false;
+}
+
+static void _build_vault_index()
+{
+    const unsigned size = vdefs.size();
+    vindex.tag_maps.assign(map_tag_count(), bit_vector(size));
+    vindex.depth_maps.clear();
+    vindex.place_maps.clear();
+    vindex.no_depth = bit_vector(size);
+
+    for (unsigned i = 0; i < size; ++i)
+    {
+        if (!vdefs[i].has_depth())
+            vindex.no_depth.set(i);
+
+        const map_tag_set &tags = vdefs[i].get_tag_ids();
+        for (int id = tags.next(0); id >= 0; id = tags.next(id + 1))
+            vindex.tag_maps[id].set(i);
+    }
+    vindex.built = true;
+}
+
+static void _check_vault_index()
+{
+    if (!vindex.built)
+        _build_vault_index();
+}
+
+// The maps whose DEPTH (or PLACE, if by_place) is usable in the given level.
+static const bit_vector &_maps_usable_in(const level_id &place, bool by_place)
+{
+    _check_vault_index();
+
+    const vault_level_key key(place.branch, place.depth,
+                              absdungeon_depth(place.branch, place.depth),
+                              brdepth[place.branch]);
+    auto &cache = by_place ? vindex.place_maps : vindex.depth_maps;
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+
+    bit_vector &maps = cache.emplace(key, bit_vector(vdefs.size()))
+                            .first->second;
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+        if ((by_place ? vdefs[i].place : vdefs[i].depths).is_usable_in(place))
+            maps.set(i);
+    return maps;
+}
+
+// The maps which have all of the given tags and, if check_depth, are
+// usable in the given place or have no depth at all.
+static bit_vector _maps_with_tags(const unordered_set<string> &tags,
+                                  bool check_depth, const level_id &place)
+{
+    _check_vault_index();
+
+    bit_vector maps(vdefs.size());
+    // map_def::has_all_tags() never matches an empty set of tags.
+    if (tags.empty())
+        return maps;
+
+    bool first = true;
+    for (const string &tag : tags)
+    {
+        // Tags interned since the index was built belong to no map in it.
+        const int id = find_map_tag_id(tag);
+        if (id < 0 || id >= (int) vindex.tag_maps.size())
+            return bit_vector(vdefs.size());
+
+        if (first)
+            maps |= vindex.tag_maps[id];
+        else
+            maps &= vindex.tag_maps[id];
+        first = false;
+    }
+
+    if (check_depth && !_debug_ignore_depth && place.is_valid())
+    {
+        bit_vector usable(vindex.no_depth);
+        usable |= _maps_usable_in(place, false);
+        maps &= usable;
+    }
+    return maps;
 }
 
 const map_def *find_map_by_name(const string &name)
@@ -744,7 +891,7 @@ const map_def *find_map_by_name(const string &name)
 }
 
 // Discards Lua code loaded by all maps to reduce memory use. If any stripped
-// map is reused, its data will be reloaded from the .dsc
+// map is reused, its data will be reloaded from the vault pack.
 void strip_all_maps()
 {
     for (map_def &mapdef : vdefs)
@@ -768,9 +915,12 @@ mapref_vector find_maps_for_tag(const string &tag,
     mapref_vector maps;
     level_id place = level_id::current();
     unordered_set<string> tag_set = parse_tags(tag);
+    const bit_vector candidates = _maps_with_tags(tag_set, check_depth, place);
 
-    for (const map_def &mapdef : vdefs)
+    for (unsigned i = candidates.next_set(0), size = vdefs.size(); i < size;
+         i = candidates.next_set(i + 1))
     {
+        const map_def &mapdef = vdefs[i];
         if (mapdef.has_all_tags(tag_set.begin(), tag_set.end())
             && !mapdef.has_tag("dummy")
             && (!check_depth || _debug_ignore_depth
@@ -797,6 +947,7 @@ private:
 
 public:
     bool accept(const map_def &md) const;
+    bit_vector candidates() const;
     void announce(const map_def *map) const;
 
     bool valid() const
@@ -879,13 +1030,13 @@ bool map_selector::depth_selectable(const map_def &mapdef) const
     return mapdef.is_usable_in(place)
            // Some tagged levels cannot be selected as random
            // maps in a specific depth:
-           && !mapdef.has_tag_suffix("entry")
-           && !mapdef.has_tag("unrand")
-           && !mapdef.has_tag("place_unique")
-           && !mapdef.has_tag("tutorial")
-           && (!mapdef.has_tag_prefix("temple_")
+           && !mapdef.has_tag_in(entry_tags)
+           && !mapdef.has_tag(unrand_tag)
+           && !mapdef.has_tag(place_unique_tag)
+           && !mapdef.has_tag(tutorial_tag)
+           && (!mapdef.has_tag_in(temple_tags)
                || !_overflow_range(place)
-                  && mapdef.has_tag_prefix("uniq_altar_"))
+                  && mapdef.has_tag_in(uniq_altar_tags))
            && _map_matches_species(mapdef)
            && (!check_layout || _map_matches_layout_type(mapdef));
 }
@@ -902,7 +1053,7 @@ bool map_selector::accept(const map_def &mapdef) const
     switch (sel)
     {
     case PLACE:
-        if (mapdef.has_tag_prefix("tutorial")
+        if (mapdef.has_tag_in(tutorial_tags)
             && (!crawl_state.game_is_tutorial()
                 || !mapdef.has_tag(crawl_state.map)))
         {
@@ -919,7 +1070,7 @@ bool map_selector::accept(const map_def &mapdef) const
         const map_chance chance(mapdef.chance(place));
         return mapdef.is_minivault() == mini
                && _is_extra_compatible(extra, mapdef.is_extra_vault())
-               && (!chance.valid() || mapdef.has_tag("dummy"))
+               && (!chance.valid() || mapdef.has_tag(dummy_tag))
                && depth_selectable(mapdef)
                && !mapdef.map_already_used();
     }
@@ -929,7 +1080,7 @@ bool map_selector::accept(const map_def &mapdef) const
         const map_chance chance(mapdef.chance(place));
         // Only vaults with valid chance
         return chance.valid()
-               && !mapdef.has_tag("dummy")
+               && !mapdef.has_tag(dummy_tag)
                && depth_selectable(mapdef)
                && _is_extra_compatible(extra, mapdef.is_extra_vault())
                && !mapdef.map_already_used();
@@ -949,6 +1100,23 @@ bool map_selector::accept(const map_def &mapdef) const
     }
 }
 
+// A superset of the maps accept() might take, from the vault index.
+bit_vector map_selector::candidates() const
+{
+    switch (sel)
+    {
+    case PLACE:
+        return _maps_usable_in(place, true);
+    case DEPTH:
+    case DEPTH_AND_CHANCE:
+        return _maps_usable_in(place, false);
+    case TAG:
+        return _maps_with_tags(parse_tags(tag), check_depth, place);
+    default:
+        return bit_vector(vdefs.size());
+    }
+}
+
 void map_selector::announce(const map_def *vault) const
 {
 #ifdef DEBUG_DIAGNOSTICS
@@ -991,15 +1159,28 @@ string vault_chance_tag(const map_def &map)
 
 typedef vector<unsigned> vault_indices;
 
-static vault_indices _eligible_maps_for_selector(const map_selector &sel)
+static vault_indices _eligible_maps_for_selector(const map_selector &sel,
+                                                 bool use_index = true)
 {
     vault_indices eligible;
 
-    if (sel.valid())
+    if (!sel.valid())
+        return eligible;
+
+    if (!use_index)
     {
         for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
             if (sel.accept(vdefs[i]))
                 eligible.push_back(i);
+        return eligible;
+    }
+
+    const bit_vector candidates = sel.candidates();
+    for (unsigned i = candidates.next_set(0), size = vdefs.size(); i < size;
+         i = candidates.next_set(i + 1))
+    {
+        if (sel.accept(vdefs[i]))
+            eligible.push_back(i);
     }
 
     return eligible;
@@ -1269,203 +1450,584 @@ static void _check_des_index_dir()
     checked_des_index_dir = true;
 }
 
-string get_descache_path(const string &file, const string &ext)
+/////////////////////////////////////////////////////////////////////////////
+// The compiled vault pack.
+//
+// The global preludes, map index entries and map bodies of every .des file
+// are kept in a single file in the des cache. Startup maps that file and
+// walks its fixed-size records, rather than opening and version checking
+// three cache files per .des file; map bodies are only unmarshalled when
+// a map is first used (see map_def::load()).
+//
+// The pack is a header, the file records, the map records, the data they
+// point to, and a table of NUL-terminated names. Header and record fields
+// are all little-endian 32-bit integers, and offsets are from the start of
+// the pack.
+
+#define VAULT_PACK_MAGIC  0x50565243 // "CRVP"
+#define VAULT_PACK_FORMAT 1
+
+struct vault_pack_header
+{
+    uint32_t magic;
+    uint32_t format;
+    uint32_t major, minor;      // the save version the data was written with
+    uint32_t word_len;
+    uint32_t nfiles, nmaps;
+    uint32_t files_off, maps_off;
+    uint32_t strings_off, strings_len;
+    uint32_t size;
+};
+
+// A .des file, in the order the files were read.
+struct vault_pack_file
+{
+    uint32_t name;              // the cache name, in the string table
+    uint32_t mtime_lo, mtime_hi;
+    uint32_t prelude_off, prelude_len;
+    uint32_t first_map, nmaps;
+};
+
+// A map, in the order the maps were read.
+struct vault_pack_map
+{
+    uint32_t name;
+    uint32_t index_off, index_len; // write_index(), description and order
+    uint32_t body_off, body_len;   // write_full()
+};
+
+// Records are only made of 32-bit fields, so they can be swapped word by
+// word. They are copied out, since nothing keeps the data aligned.
+template<typename T>
+static T _get_pack_record(const unsigned char *at)
+{
+    static_assert(sizeof(T) % sizeof(uint32_t) == 0, "unpadded pack record");
+    T rec;
+    memcpy(&rec, at, sizeof(T));
+    uint32_t *words = reinterpret_cast<uint32_t *>(&rec);
+    for (size_t i = 0; i < sizeof(T) / sizeof(uint32_t); ++i)
+        words[i] = htole32(words[i]);
+    return rec;
+}
+
+template<typename T>
+static void _put_pack_record(vector<unsigned char> &out, T rec)
 {
-    const string basename = change_file_extension(get_base_filename(file), ext);
-    return _des_cache_dir(basename);
+    uint32_t *words = reinterpret_cast<uint32_t *>(&rec);
+    for (size_t i = 0; i < sizeof(T) / sizeof(uint32_t); ++i)
+        words[i] = htole32(words[i]);
+    const unsigned char *bytes = reinterpret_cast<unsigned char *>(&rec);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
 }
 
-static bool verify_file_version(const string &file, time_t mtime)
+class vault_pack
 {
+public:
+    vault_pack() : data(nullptr), size(0), hdr() { }
+    ~vault_pack() { close(); }
+
+    bool open(const string &file);
+    void close();
+    void swap(vault_pack &other);
+
+    bool is_open() const { return data; }
+    int minor() const { return hdr.minor; }
+    size_t nfiles() const { return data ? hdr.nfiles : 0; }
+    int find_file(const string &name) const
+    {
+        return lookup(files, name, -1);
+    }
+
+    vault_pack_file file(int i) const
+    {
+        return _get_pack_record<vault_pack_file>(
+            data + hdr.files_off + i * sizeof(vault_pack_file));
+    }
+    vault_pack_map map(int i) const
+    {
+        return _get_pack_record<vault_pack_map>(
+            data + hdr.maps_off + i * sizeof(vault_pack_map));
+    }
+    const char *name(uint32_t at) const
+    {
+        return reinterpret_cast<const char *>(data + hdr.strings_off + at);
+    }
+
+public:
+    const unsigned char *data;
+    size_t size;
+
+private:
+    bool in_range(uint64_t off, uint64_t len) const
+    {
+        return off <= size && len <= size - off;
+    }
+    bool check();
+
+private:
+    vault_pack_header hdr;
+    unordered_map<string, int> files;
+#ifndef UNIX
+    vector<unsigned char> buf;
+#endif
+};
+
+bool vault_pack::open(const string &file)
+{
+    close();
+#ifdef UNIX
+    // Each game maps the same pages, rather than keeping a copy.
+    const int fd = open_u(file.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    void *m = MAP_FAILED;
+    if (!fstat(fd, &st) && st.st_size > 0)
+        m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    data = static_cast<const unsigned char *>(m);
+    size = st.st_size;
+#else
     FILE *fp = fopen_u(file.c_str(), "rb");
     if (!fp)
         return false;
-    try
-    {
-        reader inf(fp);
-        const auto version = get_save_version(inf);
-        const auto major = version.major, minor = version.minor;
-        const int8_t word = unmarshallByte(inf);
-        const int64_t t = unmarshallSigned(inf);
-        fclose(fp);
-        return major == TAG_MAJOR_VERSION
-               && minor <= TAG_MINOR_VERSION
-               && word == WORD_LEN
-               && t == mtime;
-    }
-    catch (short_read_exception &E)
-    {
-        fclose(fp);
+    buf.resize(file_size(fp));
+    const bool ok = fread(buf.data(), 1, buf.size(), fp) == buf.size();
+    fclose(fp);
+    if (!ok || buf.empty())
+    {
+        buf.clear();
         return false;
     }
+    data = buf.data();
+    size = buf.size();
+#endif
+
+    if (!check())
+    {
+        close();
+        return false;
+    }
+    return true;
 }
 
-static bool _verify_map_index(const string &base, time_t mtime)
+void vault_pack::close()
 {
-    return verify_file_version(base + ".idx", mtime);
+#ifdef UNIX
+    if (data)
+        munmap(const_cast<unsigned char *>(data), size);
+#else
+    buf.clear();
+#endif
+    data = nullptr;
+    size = 0;
+    hdr = vault_pack_header();
+    files.clear();
 }
 
-static bool _verify_map_full(const string &base, time_t mtime)
+void vault_pack::swap(vault_pack &other)
 {
-    return verify_file_version(base + ".dsc", mtime);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(hdr, other.hdr);
+    files.swap(other.files);
+#ifndef UNIX
+    buf.swap(other.buf);
+#endif
 }
 
-static bool _load_map_index(const string& cache, const string &base,
-                            time_t mtime)
+// A stale or damaged pack is simply rebuilt, so check everything the
+// records point at before trusting any of it.
+bool vault_pack::check()
 {
-    // If there's a global prelude, load that first.
-    if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
+    if (size < sizeof(vault_pack_header))
+        return false;
+    hdr = _get_pack_record<vault_pack_header>(data);
+    if (hdr.magic != VAULT_PACK_MAGIC
+        || hdr.format != VAULT_PACK_FORMAT
+        || hdr.major != TAG_MAJOR_VERSION
+        || hdr.minor > TAG_MINOR_VERSION
+        || (int32_t) hdr.word_len != WORD_LEN
+        || hdr.size != size
+        || !in_range(hdr.files_off,
+                     (uint64_t) hdr.nfiles * sizeof(vault_pack_file))
+        || !in_range(hdr.maps_off,
+                     (uint64_t) hdr.nmaps * sizeof(vault_pack_map))
+        || !hdr.strings_len
+        || !in_range(hdr.strings_off, hdr.strings_len)
+        || data[hdr.strings_off + hdr.strings_len - 1])
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < hdr.nfiles; ++i)
     {
-        reader inf(fp, TAG_MINOR_VERSION);
-        const auto version = get_save_version(inf);
-        const auto major = version.major, minor = version.minor;
-        int8_t word = unmarshallByte(inf);
-        int64_t t = unmarshallSigned(inf);
-        if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
-            || word != WORD_LEN || t != mtime)
+        const vault_pack_file f = file(i);
+        if (f.name >= hdr.strings_len
+            || !in_range(f.prelude_off, f.prelude_len)
+            || (uint64_t) f.first_map + f.nmaps > hdr.nmaps)
         {
             return false;
         }
+        files[name(f.name)] = i;
+    }
 
-        lc_global_prelude.read(inf);
-        fclose(fp);
-
-        global_preludes.push_back(lc_global_prelude);
+    for (uint32_t i = 0; i < hdr.nmaps; ++i)
+    {
+        const vault_pack_map m = map(i);
+        if (m.name >= hdr.strings_len
+            || !in_range(m.index_off, m.index_len)
+            || !in_range(m.body_off, m.body_len))
+        {
+            return false;
+        }
     }
+    return true;
+}
 
-    FILE* fp = fopen_u((base + ".idx").c_str(), "rb");
-    if (!fp)
-        end(1, true, "Unable to read %s", (base + ".idx").c_str());
+static vault_pack vpack;
+
+// A .des file read by read_maps(), and where its maps ended up in vdefs.
+struct des_file_maps
+{
+    string name;
+    time_t mtime;
+    int packed;                 // its record in vpack, or -1 if it was parsed
+    size_t first, count;
+    dlua_chunk prelude;
+};
+
+// Set while read_maps() is running, so the pack can be brought up to date
+// once every .des file has been read.
+static bool reading_all_maps = false;
+static vector<des_file_maps> des_files_read;
+
+static string _vault_pack_path()
+{
+    return _des_cache_dir("vaults.pak");
+}
+
+static void _open_vault_pack()
+{
+    _check_des_index_dir();
+    file_lock packlock(_des_cache_dir("vaults.lk"), "rb", false);
+    vpack.open(_vault_pack_path());
+}
 
-    reader inf(fp, TAG_MINOR_VERSION);
-    // Re-check version, might have been modified in the meantime.
-    const auto version = get_save_version(inf);
-    const auto major = version.major, minor = version.minor;
-    int8_t word = unmarshallByte(inf);
-    int64_t t = unmarshallSigned(inf);
-    if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
-        || word != WORD_LEN || t != mtime)
+// Stops using a pack found to be corrupt. Maps already indexed from it are
+// loaded in full first, so that read_maps() writes them to a fresh pack;
+// any whose body can't be loaded either are dropped.
+static void _discard_vault_pack()
+{
+    for (int i = vdefs.size() - 1; i >= 0; --i)
     {
-        return false;
+        map_def &vdef(vdefs[i]);
+        try
+        {
+            vdef.load();
+        }
+        catch (map_load_exception &E)
+        {
+            mprf(MSGCH_ERROR, "Dropping map: %s", E.what());
+            lc_loaded_maps.erase(vdef.name);
+            vdefs.erase(vdefs.begin() + i);
+            for (des_file_maps &f : des_files_read)
+            {
+                if (f.first > (size_t) i)
+                    --f.first;
+                else if (f.first + f.count > (size_t) i)
+                    --f.count;
+            }
+            continue;
+        }
+
+        auto place = lc_loaded_maps.find(vdef.name);
+        if (place != lc_loaded_maps.end())
+            vdef.place_loaded_from = place->second;
     }
+    _vault_index_changed();
 
-#if TAG_MAJOR_VERSION == 34
-    // Throw out indices that could have CHANCE priority entirely.
-    if (minor < TAG_MINOR_NO_PRIORITY)
+    for (des_file_maps &f : des_files_read)
+    {
+        if (f.packed == -1)
+            continue;
+        const vault_pack_file rec = vpack.file(f.packed);
+        if (rec.prelude_len)
+        {
+            reader inf(vpack.data + rec.prelude_off, rec.prelude_len,
+                       vpack.minor());
+            f.prelude.read(inf);
+        }
+        f.packed = -1;
+    }
+
+    vpack.close();
+}
+
+static bool _load_packed_maps(const string &cache, time_t mtime)
+{
+    const int fi = vpack.is_open() ? vpack.find_file(cache) : -1;
+    if (fi == -1)
+        return false;
+
+    const vault_pack_file rec = vpack.file(fi);
+    if (((int64_t) rec.mtime_hi << 32 | rec.mtime_lo) != (int64_t) mtime)
         return false;
-#endif
 
-    const int nmaps = unmarshallShort(inf);
-    const int nexist = vdefs.size();
-    vdefs.resize(nexist + nmaps, map_def());
-    for (int i = 0; i < nmaps; ++i)
+    if (rec.prelude_len)
     {
+        reader inf(vpack.data + rec.prelude_off, rec.prelude_len,
+                   vpack.minor());
+        lc_global_prelude.read(inf);
+        global_preludes.push_back(lc_global_prelude);
+    }
+
+    const size_t nexist = vdefs.size();
+    vdefs.resize(nexist + rec.nmaps, map_def());
+    _vault_index_changed();
+    for (uint32_t i = 0; i < rec.nmaps; ++i)
+    {
+        const vault_pack_map m = vpack.map(rec.first_map + i);
         map_def &vdef(vdefs[nexist + i]);
+
+        reader inf(vpack.data + m.index_off, m.index_len, vpack.minor());
         vdef.read_index(inf);
         vdef.description = unmarshallString(inf);
         vdef.order = unmarshallInt(inf);
+        if (vdef.name != vpack.name(m.name))
+        {
+            mprf(MSGCH_ERROR, "Vault pack is corrupt: map %s is indexed as %s",
+                 vdef.name.c_str(), vpack.name(m.name));
+
+            // Forget this file's maps, and parse it again instead.
+            for (uint32_t j = 0; j < i; ++j)
+                lc_loaded_maps.erase(vdefs[nexist + j].name);
+            vdefs.resize(nexist);
+            _vault_index_changed();
+            if (rec.prelude_len)
+                global_preludes.pop_back();
+            _discard_vault_pack();
+            return false;
+        }
 
+        // The offset in the index is from whichever pack it was first
+        // written to.
+        vdef.set_cache_offset(m.body_off);
         vdef.set_file(cache);
         lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
         vdef.place_loaded_from.clear();
     }
-    fclose(fp);
 
+    if (reading_all_maps)
+        des_files_read.push_back({cache, mtime, fi, nexist, rec.nmaps});
     return true;
 }
 
-static bool _load_map_cache(const string &filename, const string &cachename)
+static bool _vault_pack_current()
 {
-    _check_des_index_dir();
-    const string descache_base = get_descache_path(cachename, "");
+    if (des_files_read.size() != vpack.nfiles())
+        return false;
+    for (size_t i = 0; i < des_files_read.size(); ++i)
+        if (des_files_read[i].packed != (int) i)
+            return false;
+    return true;
+}
 
-    file_lock deslock(descache_base + ".lk", "rb", false);
+// Writes a new pack of everything read since read_maps() started. Maps
+// still in the old pack are copied across as they are, and only the maps
+// that were parsed are marshalled. If the old pack was written by another
+// minor version, the new pack's header would misdescribe its records, so
+// they are all marshalled again instead.
+static void _write_vault_pack()
+{
+    if (_vault_pack_current())
+        return;
 
-    time_t mtime = file_modtime(filename);
-    string file_idx = descache_base + ".idx";
-    string file_dsc = descache_base + ".dsc";
+    const bool copy_old = vpack.minor() == TAG_MINOR_VERSION;
+
+    size_t nmaps = 0;
+    for (const des_file_maps &f : des_files_read)
+        nmaps += f.count;
+
+    vault_pack_header hdr = vault_pack_header();
+    hdr.magic = VAULT_PACK_MAGIC;
+    hdr.format = VAULT_PACK_FORMAT;
+    hdr.major = TAG_MAJOR_VERSION;
+    hdr.minor = TAG_MINOR_VERSION;
+    hdr.word_len = WORD_LEN;
+    hdr.nfiles = des_files_read.size();
+    hdr.nmaps = nmaps;
+    hdr.files_off = sizeof(vault_pack_header);
+    hdr.maps_off = hdr.files_off + hdr.nfiles * sizeof(vault_pack_file);
+
+    const uint32_t data_off = hdr.maps_off + nmaps * sizeof(vault_pack_map);
+    vector<unsigned char> data;
+    string strings;
+    vector<vault_pack_file> file_recs;
+    vector<vault_pack_map> map_recs;
+
+    auto add_name = [&strings](const string &s)
+    {
+        const uint32_t at = strings.size();
+        strings.append(s.c_str(), s.length() + 1);
+        return at;
+    };
+    auto copy_data = [&data, data_off](const unsigned char *from, size_t len)
+    {
+        const uint32_t at = data_off + data.size();
+        data.insert(data.end(), from, from + len);
+        return at;
+    };
 
-    // What's the point in checking these twice (here and in load_ma_index)?
-    if (!_verify_map_index(descache_base, mtime)
-        || !_verify_map_full(descache_base, mtime))
+    for (const des_file_maps &f : des_files_read)
     {
-        return false;
-    }
+        vault_pack_file frec = vault_pack_file();
+        frec.name = add_name(f.name);
+        frec.mtime_lo = (uint64_t) f.mtime & 0xffffffff;
+        frec.mtime_hi = (uint64_t) f.mtime >> 32;
+        frec.first_map = map_recs.size();
+        frec.nmaps = f.count;
+
+        const vault_pack_file old = f.packed == -1 ? vault_pack_file()
+                                                   : vpack.file(f.packed);
+        if (f.packed != -1 && copy_old)
+        {
+            frec.prelude_off = copy_data(vpack.data + old.prelude_off,
+                                         old.prelude_len);
+            frec.prelude_len = old.prelude_len;
+        }
+        else
+        {
+            dlua_chunk prelude = f.prelude;
+            if (f.packed != -1 && old.prelude_len)
+            {
+                reader inf(vpack.data + old.prelude_off, old.prelude_len,
+                           vpack.minor());
+                prelude.read(inf);
+            }
+            if (!prelude.empty())
+            {
+                frec.prelude_off = data_off + data.size();
+                writer outf(&data);
+                prelude.write(outf);
+                frec.prelude_len = data_off + data.size() - frec.prelude_off;
+            }
+        }
+        file_recs.push_back(frec);
 
-    return _load_map_index(cachename, descache_base, mtime);
-}
+        for (size_t i = 0; i < f.count; ++i)
+        {
+            map_def &vdef(vdefs[f.first + i]);
+            vault_pack_map mrec = vault_pack_map();
+            mrec.name = add_name(vdef.name);
 
-static void _write_map_prelude(const string &filebase, time_t mtime)
-{
-    const string luafile = filebase + ".lux";
-    if (lc_global_prelude.empty())
-    {
-        unlink_u(luafile.c_str());
-        return;
+            if (f.packed != -1 && copy_old)
+            {
+                const vault_pack_map m = vpack.map(old.first_map + i);
+                mrec.body_off = copy_data(vpack.data + m.body_off,
+                                          m.body_len);
+                mrec.body_len = m.body_len;
+                mrec.index_off = copy_data(vpack.data + m.index_off,
+                                           m.index_len);
+                mrec.index_len = m.index_len;
+            }
+            else
+            {
+                // A map still in the old pack only has its index in
+                // memory, so load a copy of it in full to marshall.
+                unique_ptr<map_def> loaded;
+                if (f.packed != -1)
+                {
+                    loaded.reset(new map_def(vdef));
+                    loaded->load();
+                    loaded->place_loaded_from = lc_loaded_maps[vdef.name];
+                }
+                map_def &src = loaded ? *loaded : vdef;
+
+                writer outf(&data);
+                mrec.body_off = data_off + data.size();
+                src.write_full(outf);
+                mrec.body_len = data_off + data.size() - mrec.body_off;
+
+                // write_index() stores the body's offset.
+                src.set_cache_offset(mrec.body_off);
+                mrec.index_off = data_off + data.size();
+                src.write_index(outf);
+                marshallString(outf, src.description);
+                marshallInt(outf, src.order);
+                mrec.index_len = data_off + data.size() - mrec.index_off;
+            }
+            map_recs.push_back(mrec);
+        }
     }
 
-    FILE *fp = fopen_u(luafile.c_str(), "wb");
-    writer outf(luafile, fp);
-    write_save_version(outf, save_version::current());
-    marshallByte(outf, WORD_LEN);
-    marshallSigned(outf, mtime);
-    lc_global_prelude.write(outf);
-    fclose(fp);
-}
-
-static void _write_map_full(const string &filebase, size_t vs, size_t ve,
-                            time_t mtime)
-{
-    const string cfile = filebase + ".dsc";
-    FILE *fp = fopen_u(cfile.c_str(), "wb");
-    if (!fp)
-        end(1, true, "Unable to open %s for writing", cfile.c_str());
-
-    writer outf(cfile, fp);
-    write_save_version(outf, save_version::current());
-    marshallByte(outf, WORD_LEN);
-    marshallSigned(outf, mtime);
-    for (size_t i = vs; i < ve; ++i)
-        vdefs[i].write_full(outf);
-    fclose(fp);
-}
+    hdr.strings_off = data_off + data.size();
+    hdr.strings_len = strings.size();
+    hdr.size = hdr.strings_off + hdr.strings_len;
+
+    vector<unsigned char> out;
+    out.reserve(hdr.size);
+    _put_pack_record(out, hdr);
+    for (const vault_pack_file &frec : file_recs)
+        _put_pack_record(out, frec);
+    for (const vault_pack_map &mrec : map_recs)
+        _put_pack_record(out, mrec);
+    out.insert(out.end(), data.begin(), data.end());
+    out.insert(out.end(), strings.begin(), strings.end());
+    ASSERT(out.size() == hdr.size);
 
-static void _write_map_index(const string &filebase, size_t vs, size_t ve,
-                             time_t mtime)
-{
-    const string cfile = filebase + ".idx";
-    FILE *fp = fopen_u(cfile.c_str(), "wb");
-    if (!fp)
-        end(1, true, "Unable to open %s for writing", cfile.c_str());
+    _check_des_index_dir();
+    const string packfile = _vault_pack_path();
+    const string tmpfile = packfile + ".tmp";
+    vault_pack fresh;
+    {
+        file_lock packlock(_des_cache_dir("vaults.lk"), "wb");
+
+        // Games that already have the old pack mapped keep reading it.
+        FILE *fp = fopen_u(tmpfile.c_str(), "wb");
+        if (!fp)
+            end(1, true, "Unable to open %s for writing", tmpfile.c_str());
+        const bool written = fwrite(out.data(), 1, out.size(), fp) == out.size();
+        if (fclose(fp) || !written)
+            end(1, true, "Unable to write %s", tmpfile.c_str());
+        if (rename_u(tmpfile.c_str(), packfile.c_str()))
+            end(1, true, "Unable to replace %s", packfile.c_str());
+
+        if (!fresh.open(packfile))
+            end(1, true, "Unable to read %s", packfile.c_str());
+
+        // The .idx, .dsc and .lux caches that the pack replaced are no
+        // longer read, so don't leave them lying around.
+        for (const des_file_maps &f : des_files_read)
+            for (const char *ext : { ".idx", ".dsc", ".lux" })
+                unlink_u(_des_cache_dir(f.name + ext).c_str());
+    }
+    vpack.swap(fresh);
 
-    writer outf(cfile, fp);
-    write_save_version(outf, save_version::current());
-    marshallByte(outf, WORD_LEN);
-    marshallSigned(outf, mtime);
-    marshallShort(outf, ve > vs? ve - vs : 0);
-    for (size_t i = vs; i < ve; ++i)
+    // Everything can now be loaded from the new pack on demand.
+    size_t k = 0;
+    for (des_file_maps &f : des_files_read)
     {
-        vdefs[i].write_index(outf);
-        marshallString(outf, vdefs[i].description);
-        marshallInt(outf, vdefs[i].order);
-        vdefs[i].place_loaded_from.clear();
-        vdefs[i].strip();
+        for (size_t i = 0; i < f.count; ++i, ++k)
+        {
+            map_def &vdef(vdefs[f.first + i]);
+            vdef.set_cache_offset(map_recs[k].body_off);
+            if (f.packed == -1)
+            {
+                vdef.place_loaded_from.clear();
+                vdef.strip();
+            }
+        }
     }
-    fclose(fp);
 }
 
-static void _write_map_cache(const string &filename, size_t vs, size_t ve,
-                             time_t mtime)
+const unsigned char *vault_pack_data(size_t &size, int &minor)
 {
-    _check_des_index_dir();
-
-    const string descache_base = get_descache_path(filename, "");
-
-    file_lock deslock(descache_base + ".lk", "wb");
-
-    _write_map_prelude(descache_base, mtime);
-    _write_map_full(descache_base, vs, ve, mtime);
-    _write_map_index(descache_base, vs, ve, mtime);
+    size = vpack.size;
+    minor = vpack.minor();
+    return vpack.data;
 }
 
 static void _parse_maps(const string &s)
@@ -1476,7 +2038,8 @@ static void _parse_maps(const string &s)
 
     map_files_read.insert(cache_name);
 
-    if (_load_map_cache(s, cache_name))
+    const time_t mtime = file_modtime(s);
+    if (_load_packed_maps(cache_name, mtime))
         return;
 
     FILE *dat = fopen_u(s.c_str(), "r");
@@ -1489,7 +2052,6 @@ static void _parse_maps(const string &s)
     // won't be seen by the user unless they look for it
     mprf(MSGCH_PLAIN, "Regenerating des: %s", s.c_str());
 
-    time_t mtime = file_modtime(dat);
     _reset_map_parser();
 
     extern int yyparse();
@@ -1502,7 +2064,13 @@ static void _parse_maps(const string &s)
 
     global_preludes.push_back(lc_global_prelude);
 
-    _write_map_cache(cache_name, file_start, vdefs.size(), mtime);
+    // Maps read outside read_maps() aren't packed, and stay in memory.
+    if (reading_all_maps)
+    {
+        des_files_read.push_back({cache_name, mtime, -1, file_start,
+                                  vdefs.size() - file_start,
+                                  lc_global_prelude});
+    }
 }
 
 void read_map(const string &file)
@@ -1515,8 +2083,18 @@ void read_map(const string &file)
 
 void read_maps()
 {
+    // On a reread, the pack already open is brought up to date below.
+    if (!vpack.is_open())
+        _open_vault_pack();
+
+    des_files_read.clear();
+    reading_all_maps = true;
     if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
         end(1, false, "Lua error: %s", dlua.error.c_str());
+    reading_all_maps = false;
+
+    _write_vault_pack();
+    des_files_read.clear();
 
     lc_loaded_maps.clear();
 
@@ -1529,7 +2107,7 @@ void read_maps()
     }
 }
 
-// If a .dsc file has been changed under the running Crawl, discard
+// If a .des file has been changed under the running Crawl, discard
 // all map knowledge and reload maps. This will not affect maps that
 // have already been used, but it might trigger exciting happenings if
 // the new maps fail sanity checks or remove maps that the game
@@ -1541,6 +2119,7 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    _vault_index_changed();
     map_files_read.clear();
     read_maps();
 }
@@ -1560,6 +2139,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    _vault_index_changed();
 }
 
 void run_map_global_preludes()
@@ -1588,6 +2168,8 @@ void run_map_local_preludes()
             }
         }
     }
+    // A prelude could have changed its map's tags.
+    _vault_index_changed();
 }
 
 const map_def *map_by_index(int index)
@@ -1675,4 +2257,61 @@ void mapstat_report_random_maps(FILE *outf, const level_id &place)
     _report_random_vaults(outf, place, false);
 }
 
+/**
+ * Time map selection for the given levels with and without the vault
+ * index, and check that both find the same maps.
+ */
+void mapstat_report_vault_index(FILE *outf, const vector<level_id> &levels)
+{
+    const int rounds = 5;
+    const char *tags[] = { "layout", "arrival", "place_unique" };
+    typedef chrono::steady_clock clock;
+    clock::duration indexed(0), full(0);
+    int selections = 0, mismatches = 0;
+
+    for (const level_id &place : levels)
+    {
+        vector<map_selector> sels =
+        {
+            map_selector::by_place(place, false, MB_MAYBE),
+            map_selector::by_place(place, true, MB_MAYBE),
+            map_selector::by_depth(place, false, MB_MAYBE),
+            map_selector::by_depth(place, true, MB_MAYBE),
+            map_selector::by_depth_chance(place, MB_MAYBE),
+        };
+        for (const char *tag : tags)
+            sels.push_back(map_selector::by_tag(tag, true, true, MB_MAYBE,
+                                                place));
+
+        for (const map_selector &sel : sels)
+        {
+            const clock::time_point start = clock::now();
+            vault_indices with_index;
+            for (int i = 0; i < rounds; ++i)
+                with_index = _eligible_maps_for_selector(sel, true);
+            const clock::time_point mid = clock::now();
+            vault_indices without_index;
+            for (int i = 0; i < rounds; ++i)
+                without_index = _eligible_maps_for_selector(sel, false);
+            indexed += mid - start;
+            full += clock::now() - mid;
+
+            ++selections;
+            if (with_index != without_index)
+                ++mismatches;
+        }
+    }
+
+    fprintf(outf, "\n\nVault selection (%d selections, %d rounds each):\n",
+            selections, rounds);
+    fprintf(outf, "indexed: %.1f ms, full scan: %.1f ms\n",
+            chrono::duration<double, milli>(indexed).count(),
+            chrono::duration<double, milli>(full).count());
+    if (mismatches)
+    {
+        fprintf(outf, "WARNING: %d selections found different maps with and "
+                      "without the index!\n", mismatches);
+    }
+}
+
 #endif //DEBUG_STATISTICS
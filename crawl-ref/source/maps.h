@@ -60,7 +60,7 @@ void reread_maps();
 void read_map(const string &file);
 void run_map_global_preludes();
 void run_map_local_preludes();
-string get_descache_path(const string &file, const string &ext);
+const unsigned char *vault_pack_data(size_t &size, int &minor);
 
 typedef map<string, map_file_place> map_load_info_t;
 
@@ -94,4 +94,5 @@ private:
 
 #ifdef DEBUG_STATISTICS
 void mapstat_report_random_maps(FILE *outf, const level_id &place);
+void mapstat_report_vault_index(FILE *outf, const vector<level_id> &levels);
 #endif
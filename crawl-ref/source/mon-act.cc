@@ -44,6 +44,7 @@
 #include "mon-cast.h"
 #include "mon-death.h"
 #include "mon-movetarget.h"
+#include "mon-pathfind.h"
 #include "mon-place.h"
 #include "mon-poly.h"
 #include "mon-project.h"
@@ -2240,16 +2241,70 @@ static void _post_monster_move(monster* mons)
         monster_die(*mons, KILL_MISC, NON_MONSTER);
 }
 
-priority_queue<pair<monster *, int>,
-               vector<pair<monster *, int> >,
-               MonsterActionQueueCompare> monster_queue;
+void monster_action_queue::push(monster* mon, int energy)
+{
+    if (buckets.empty())
+        lowest = energy;
+    else if (energy < lowest)
+    {
+        // Rare: only monsters given an action without the energy for it.
+        const int shift = lowest - energy;
+        buckets.insert(buckets.begin(), shift, bucket());
+        lowest = energy;
+        if (top >= 0)
+            top += shift;
+    }
+
+    const int i = energy - lowest;
+    if (i >= (int)buckets.size())
+        buckets.resize(i + 1);
+    buckets[i].queued.emplace_back(mon, energy);
+    top = max(top, i);
+    count++;
+}
+
+const pair<monster*, int>& monster_action_queue::peek() const
+{
+    ASSERT(!empty());
+    const bucket &b = buckets[top];
+    return b.queued[b.next];
+}
+
+pair<monster*, int> monster_action_queue::pop()
+{
+    ASSERT(!empty());
+    bucket &b = buckets[top];
+    const pair<monster*, int> next = b.queued[b.next++];
+    if (b.empty())
+    {
+        b.queued.clear();
+        b.next = 0;
+    }
+    count--;
+    while (top >= 0 && buckets[top].empty())
+        top--;
+    return next;
+}
+
+void monster_action_queue::clear()
+{
+    for (bucket &b : buckets)
+    {
+        b.queued.clear();
+        b.next = 0;
+    }
+    top = -1;
+    count = 0;
+}
+
+static monster_action_queue monster_queue;
 
 // Inserts a monster into the monster queue (needed to ensure that any monsters
 // given energy or an action by a effect can actually make use of that energy
 // this round)
 void queue_monster_for_action(monster* mons)
 {
-    monster_queue.emplace(mons, mons->speed_increment);
+    monster_queue.push(mons, mons->speed_increment);
 }
 
 static void _clear_monster_flags()
@@ -2324,11 +2379,13 @@ static void _display_just_seen()
  */
 void handle_monsters(bool with_noise)
 {
+    invalidate_shared_pathfinding();
+
     for (monster_iterator mi; mi; ++mi)
     {
         _pre_monster_move(**mi);
         if (!invalid_monster(*mi) && mi->alive() && mi->has_action_energy())
-            monster_queue.emplace(*mi, mi->speed_increment);
+            monster_queue.push(*mi, mi->speed_increment);
     }
 
     int tries = 0; // infinite loop protection, shouldn't be ever needed
@@ -2337,13 +2394,13 @@ void handle_monsters(bool with_noise)
         if (tries++ > 32767)
         {
             die("infinite handle_monsters() loop, mons[0 of %d] is %s",
-                (int)monster_queue.size(),
-                monster_queue.top().first->name(DESC_PLAIN, true).c_str());
+                monster_queue.size(),
+                monster_queue.peek().first->name(DESC_PLAIN, true).c_str());
         }
 
-        monster *mon = monster_queue.top().first;
-        const int oldspeed = monster_queue.top().second;
-        monster_queue.pop();
+        monster *mon;
+        int oldspeed;
+        tie(mon, oldspeed) = monster_queue.pop();
 
         if (invalid_monster(mon) || !mon->alive() || !mon->has_action_energy())
             continue;
@@ -2362,7 +2419,7 @@ void handle_monsters(bool with_noise)
         }
 
         if (mon->has_action_energy())
-            monster_queue.emplace(mon, mon->speed_increment);
+            monster_queue.push(mon, mon->speed_increment);
 
         // If the player got banished, discard pending monster actions.
         if (you.banished)
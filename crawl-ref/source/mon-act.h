@@ -6,6 +6,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "coord-def.h"
 
@@ -14,13 +15,39 @@ using std::pair;
 class monster;
 struct bolt;
 
-class MonsterActionQueueCompare
+// Monsters waiting to act this turn, bucketed by their energy at the time
+// they were queued. Monsters with more energy act first; monsters with the
+// same energy act in the order they were queued, so that the action order
+// only depends on the order of the monster list. Pushing and popping are
+// O(1), apart from skipping empty buckets, and the buckets are kept between
+// turns.
+class monster_action_queue
 {
 public:
-    bool operator() (pair<monster*, int> m1, pair<monster*, int> m2)
+    monster_action_queue() : lowest(0), top(-1), count(0) { }
+
+    void push(monster* mon, int energy);
+    pair<monster*, int> pop();
+    const pair<monster*, int>& peek() const;
+
+    bool empty() const { return count == 0; }
+    int size() const { return count; }
+    void clear();
+
+private:
+    // The monsters queued with one energy, popped from next onwards.
+    struct bucket
     {
-        return m1.second < m2.second;
-    }
+        vector<pair<monster*, int>> queued;
+        size_t next = 0;
+
+        bool empty() const { return next == queued.size(); }
+    };
+
+    vector<bucket> buckets; // buckets[i] is for energy lowest + i
+    int lowest;
+    int top;                // The highest non-empty bucket, or -1.
+    int count;
 };
 
 void mons_set_just_seen(monster *mon);
@@ -214,7 +214,7 @@ bool try_pathfind(monster* mon)
     monster_pathfind mp;
     mp.set_range(range);
 
-    if (mp.init_pathfind(mon, targpos))
+    if (mp.init_shared_pathfind(mon, targpos))
     {
         mon->travel_path = mp.calc_waypoints();
         if (!mon->travel_path.empty())
@@ -2,12 +2,15 @@
 
 #include "mon-pathfind.h"
 
+#include <bitset>
+
 #include "directn.h"
 #include "env.h"
 #include "los.h"
 #include "misc.h"
 #include "mon-movetarget.h"
 #include "mon-place.h"
+#include "mon-util.h"
 #include "religion.h"
 #include "state.h"
 #include "terrain.h"
@@ -29,6 +32,115 @@
 // then there's no path that matches the requirements fed into monster_pathfind.
 // (These requirements are usually preference of habitat of a specific monster
 // or a limit of the distance between start and any grid on the path.)
+//
+// The "hash" is a bucket queue: one intrusive doubly-linked list of grids per
+// estimated total distance, threaded through per-grid link arrays, so nothing
+// is allocated while searching. All per-grid state lives in a pathfind_arena.
+// Arenas are large, so they are pooled and reused rather than being built for
+// every search, and instead of clearing them each search bumps a generation
+// number: any entry stamped with an older generation counts as unset.
+
+#define NO_GRID (-1)
+
+struct pathfind_arena
+{
+    // The current search; entries stamped with anything else are stale.
+    unsigned int generation;
+
+    // dist and prev are valid iff visited == generation.
+    unsigned int visited[GXM][GYM];
+    // The array of distances from start to any already tried point.
+    int dist[GXM][GYM];
+    // The Compass direction we came from on a given shortest path.
+    int8_t prev[GXM][GYM];
+
+    // passable is valid iff checked == generation.
+    unsigned int checked[GXM][GYM];
+    bool passable[GXM][GYM];
+
+    // The grid is in the queue iff queued == generation.
+    unsigned int queued[GXM * GYM];
+    int link_prev[GXM * GYM];
+    int link_next[GXM * GYM];
+
+    // The last grid of each bucket, valid iff bucket_gen == generation.
+    unsigned int bucket_gen[GXM * GYM];
+    int bucket_tail[GXM * GYM];
+
+    pathfind_arena() : generation(0), visited(), checked(), queued(),
+                       bucket_gen()
+    {
+    }
+
+    void new_search()
+    {
+        if (++generation == 0)
+        {
+            // Wrapped around; old stamps could look current again.
+            memset(visited, 0, sizeof(visited));
+            memset(checked, 0, sizeof(checked));
+            memset(queued, 0, sizeof(queued));
+            memset(bucket_gen, 0, sizeof(bucket_gen));
+            generation = 1;
+        }
+    }
+
+    bool bucket_empty(int b) const
+    {
+        return bucket_gen[b] != generation || bucket_tail[b] == NO_GRID;
+    }
+
+    void push(int b, int g)
+    {
+        if (bucket_gen[b] != generation)
+        {
+            bucket_gen[b] = generation;
+            bucket_tail[b] = NO_GRID;
+        }
+        link_prev[g] = bucket_tail[b];
+        link_next[g] = NO_GRID;
+        if (bucket_tail[b] != NO_GRID)
+            link_next[bucket_tail[b]] = g;
+        bucket_tail[b] = g;
+        queued[g] = generation;
+    }
+
+    void remove(int b, int g)
+    {
+        ASSERT(queued[g] == generation);
+        if (link_next[g] != NO_GRID)
+            link_prev[link_next[g]] = link_prev[g];
+        else
+            bucket_tail[b] = link_prev[g];
+        if (link_prev[g] != NO_GRID)
+            link_next[link_prev[g]] = link_next[g];
+        queued[g] = 0;
+    }
+
+    // Remove and return the last grid added to a non-empty bucket.
+    int pop(int b)
+    {
+        const int g = bucket_tail[b];
+        remove(b, g);
+        return g;
+    }
+};
+
+// Arenas not currently owned by a monster_pathfind. Each thread keeps its
+// own, so that a search on one thread never hands out an arena in use on
+// another. (The parallel stat modes fork rather than start threads, but
+// nothing else stops a pathfinder being made off the main thread.)
+static thread_local vector<unique_ptr<pathfind_arena>> free_arenas;
+
+static int _grid_index(const coord_def& p)
+{
+    return p.x * GYM + p.y;
+}
+
+static coord_def _grid_pos(int g)
+{
+    return coord_def(g / GYM, g % GYM);
+}
 
 int mons_tracking_range(const monster* mon)
 {
@@ -63,13 +175,20 @@ int mons_tracking_range(const monster* mon)
 //#define DEBUG_PATHFIND
 monster_pathfind::monster_pathfind()
     : mons(nullptr), start(), target(), pos(), allow_diagonals(true),
-      traverse_unmapped(false), range(0), min_length(0), max_length(0),
-      dist(), prev(), hash(), traversable_cache()
+      traverse_unmapped(false), range(0), min_length(0), max_length(0)
 {
+    if (free_arenas.empty())
+        arena.reset(new pathfind_arena);
+    else
+    {
+        arena = move(free_arenas.back());
+        free_arenas.pop_back();
+    }
 }
 
 monster_pathfind::~monster_pathfind()
 {
+    free_arenas.push_back(move(arena));
 }
 
 void monster_pathfind::set_range(int r)
@@ -80,7 +199,7 @@ void monster_pathfind::set_range(int r)
 
 coord_def monster_pathfind::next_pos(const coord_def &c) const
 {
-    return c + Compass[prev[c.x][c.y]];
+    return c + Compass[arena->prev[c.x][c.y]];
 }
 
 // The main method in the monster_pathfind class.
@@ -89,6 +208,7 @@ bool monster_pathfind::init_pathfind(const monster* mon, coord_def dest,
                                      bool diag, bool msg, bool pass_unmapped)
 {
     mons   = mon;
+    field_path.clear();
 
     start  = mon->pos();
     target = dest;
@@ -114,6 +234,7 @@ bool monster_pathfind::init_pathfind(const monster* mon, coord_def dest,
 bool monster_pathfind::init_pathfind(coord_def src, coord_def dest, bool diag,
                                      bool msg)
 {
+    field_path.clear();
     start  = src;
     target = dest;
     pos    = start;
@@ -136,14 +257,10 @@ bool monster_pathfind::start_pathfind(bool msg)
     //       a wall.
 
     max_length = min_length = grid_distance(pos, target);
-    for (int i = 0; i < GXM; i++)
-        for (int j = 0; j < GYM; j++)
-        {
-            dist[i][j] = INFINITE_DISTANCE;
-            traversable_cache[i][j] = MB_MAYBE;
-        }
+    arena->new_search();
 
-    dist[pos.x][pos.y] = 0;
+    arena->visited[pos.x][pos.y] = arena->generation;
+    arena->dist[pos.x][pos.y] = 0;
 
     bool success = false;
     do
@@ -213,8 +330,8 @@ bool monster_pathfind::calc_path_to_neighbours()
         if (range && estimated_cost(npos) > range)
             continue;
 
-        distance = dist[pos.x][pos.y] + travel_cost(npos);
-        old_dist = dist[npos.x][npos.y];
+        distance = dist_at(pos) + travel_cost(npos);
+        old_dist = dist_at(npos);
 
         // Also bail out if this would make the path longer than twice the
         // allowed distance from the target. (This factor may need tuning.)
@@ -256,7 +373,8 @@ bool monster_pathfind::calc_path_to_neighbours()
             }
 
             // Update distance start->pos.
-            dist[npos.x][npos.y] = distance;
+            arena->visited[npos.x][npos.y] = arena->generation;
+            arena->dist[npos.x][npos.y] = distance;
 
             // Set backtracking information.
             // Converts the Compass direction to its counterpart.
@@ -264,7 +382,7 @@ bool monster_pathfind::calc_path_to_neighbours()
             //      7  .  3   ==>   3  .  7       e.g. (3 + 4) % 8          = 7
             //      6  5  4         2  1  0            (7 + 4) % 8 = 11 % 8 = 3
 
-            prev[npos.x][npos.y] = (dir + 4) % 8;
+            arena->prev[npos.x][npos.y] = (dir + 4) % 8;
 
             // Are we finished?
             if (npos == target)
@@ -280,22 +398,20 @@ bool monster_pathfind::calc_path_to_neighbours()
 }
 
 // Starting at known min_length (minimum total estimated path distance), check
-// the hash for existing vectors, then pick the last entry of the first vector
+// the hash for non-empty buckets, then pick the last entry of the first bucket
 // that matches. Update min_length, if necessary.
 bool monster_pathfind::get_best_position()
 {
     for (int i = min_length; i <= max_length; i++)
     {
-        if (!hash[i].empty())
+        if (!arena->bucket_empty(i))
         {
             if (i > min_length)
                 min_length = i;
 
-            vector<coord_def> &vec = hash[i];
-            // Pick the last position pushed into the vector as it's most
+            // Pick the last position pushed into the bucket as it's most
             // likely to be close to the target.
-            pos = vec[vec.size()-1];
-            vec.pop_back();
+            pos = _grid_pos(arena->pop(i));
 
 #ifdef DEBUG_PATHFIND
             mprf("Returning (%d, %d) as best pos with total dist %d.",
@@ -320,6 +436,9 @@ vector<coord_def> monster_pathfind::backtrack()
 #ifdef DEBUG_PATHFIND
     mpr("Backtracking...");
 #endif
+    if (!field_path.empty())
+        return field_path;
+
     vector<coord_def> path;
     pos = target;
     path.push_back(pos);
@@ -330,7 +449,7 @@ vector<coord_def> monster_pathfind::backtrack()
     int dir;
     do
     {
-        dir = prev[pos.x][pos.y];
+        dir = arena->prev[pos.x][pos.y];
         pos = pos + Compass[dir];
         ASSERT_IN_BOUNDS(pos);
 #ifdef DEBUG_PATHFIND
@@ -394,9 +513,12 @@ vector<coord_def> monster_pathfind::calc_waypoints()
 
 bool monster_pathfind::traversable_memoized(const coord_def& p)
 {
-    if (traversable_cache[p.x][p.y] == MB_MAYBE)
-        traversable_cache[p.x][p.y] = frombool(traversable(p));
-    return tobool(traversable_cache[p.x][p.y], false);
+    if (arena->checked[p.x][p.y] != arena->generation)
+    {
+        arena->passable[p.x][p.y] = traversable(p);
+        arena->checked[p.x][p.y] = arena->generation;
+    }
+    return arena->passable[p.x][p.y];
 }
 
 bool monster_pathfind::traversable(const coord_def& p)
@@ -493,26 +615,254 @@ int monster_pathfind::estimated_cost(coord_def p)
     return grid_distance(p, target);
 }
 
+// The distance from start to p, or INFINITE_DISTANCE if it hasn't been
+// reached yet.
+int monster_pathfind::dist_at(const coord_def& p) const
+{
+    if (arena->visited[p.x][p.y] != arena->generation)
+        return INFINITE_DISTANCE;
+    return arena->dist[p.x][p.y];
+}
+
 void monster_pathfind::add_new_pos(coord_def npos, int total)
 {
-    hash[total].push_back(npos);
+    ASSERT(total < GXM * GYM);
+    arena->push(total, _grid_index(npos));
 }
 
 void monster_pathfind::update_pos(coord_def npos, int total)
 {
     // Find hash position of old distance and delete it,
-    // then call_add_new_pos.
-    int old_total = dist[npos.x][npos.y] + estimated_cost(npos);
+    // then call_add_new_pos. Positions that have already been
+    // taken out of the hash are just added again.
+    const int g = _grid_index(npos);
+    if (arena->queued[g] == arena->generation)
+        arena->remove(dist_at(npos) + estimated_cost(npos), g);
+
+    add_new_pos(npos, total);
+}
 
-    vector<coord_def> &vec = hash[old_total];
-    for (unsigned int i = 0; i < vec.size(); i++)
+/////////////////////////////////////////////////////////////////////////////
+// Shared distance fields
+//
+// When many hostile monsters chase the same target (hordes, Ziggurats, the
+// arena), they would each run the same search every turn. Instead, once a
+// second monster of the same movement class looks for a path to the same
+// target in one turn, we fill a Dijkstra distance field outwards from the
+// target and read every further path for that class straight off it.
+//
+// Fields are dropped at the start of each monster turn and on any terrain
+// change (including doors); see set_terrain_changed().
+
+// Everything about a hostile monster that decides which grids
+// monster_pathfind lets it through, and what they cost. Monsters of the
+// same movement class get the same distances to any target, so this
+// separates walkers, flyers, swimmers, amphibians and so on.
+struct pathfind_move_class
+{
+    bitset<NUM_FEATURES> habitable;
+    bitset<NUM_FEATURES> flounders;
+    bool passes_doors;
+    bool ground_level;
+
+    explicit pathfind_move_class(const monster& mon)
+        : passes_doors(mons_can_pass_doors(mon)),
+          ground_level(mon.ground_level())
     {
-        if (vec[i] == npos)
+        for (int i = 0; i < NUM_FEATURES; ++i)
         {
-            vec.erase(vec.begin() + i);
-            break;
+            const dungeon_feature_type feat =
+                static_cast<dungeon_feature_type>(i);
+            habitable[i] = mon.is_habitable_feat(feat);
+            flounders[i] = mon.floundering_in(feat);
         }
     }
 
-    add_new_pos(npos, total);
+    bool operator==(const pathfind_move_class &other) const
+    {
+        return habitable == other.habitable
+               && flounders == other.flounders
+               && passes_doors == other.passes_doors
+               && ground_level == other.ground_level;
+    }
+};
+
+struct pathfind_field
+{
+    pathfind_move_class move_class;
+    coord_def target;
+    int range;
+
+    // Whether the distances have been filled in. A field starts out as
+    // just a note that one monster of its class wanted this target.
+    bool filled;
+
+    // The cost of travelling from a grid to the target, not counting the
+    // grid itself; INFINITE_DISTANCE if the target can't be reached.
+    int dist[GXM][GYM];
+
+    pathfind_field(const pathfind_move_class &mc, const coord_def &t, int r)
+        : move_class(mc), target(t), range(r), filled(false)
+    {
+    }
+
+    bool matches(const pathfind_move_class &mc, const coord_def &t,
+                 int r) const
+    {
+        return target == t && range == r && move_class == mc;
+    }
+};
+
+// Enough for several groups chasing several targets.
+#define MAX_SHARED_FIELDS 16
+
+static vector<unique_ptr<pathfind_field>> shared_fields;
+
+void invalidate_shared_pathfinding()
+{
+    shared_fields.clear();
+}
+
+// Fill in the distances from every grid in range to target, using the same
+// traversability and costs as the A* search.
+void monster_pathfind::fill_field(pathfind_field &field)
+{
+    arena->new_search();
+
+    const int max_dist = range * 2;
+    arena->visited[target.x][target.y] = arena->generation;
+    arena->dist[target.x][target.y] = 0;
+    arena->push(0, _grid_index(target));
+
+    for (int d = 0; d <= max_dist; d++)
+    {
+        while (!arena->bucket_empty(d))
+        {
+            const coord_def next = _grid_pos(arena->pop(d));
+            for (int dir = 0; dir < 8; dir++)
+            {
+                pos = next + Compass[dir];
+                if (!in_bounds(pos)
+                    || estimated_cost(pos) > range
+                    || !traversable_memoized(pos))
+                {
+                    continue;
+                }
+
+                // Monsters pay for each grid they step into.
+                const int distance = d + travel_cost(next);
+                const int old_dist = dist_at(pos);
+                if (distance > max_dist || distance >= old_dist)
+                    continue;
+
+                if (old_dist != INFINITE_DISTANCE
+                    && arena->queued[_grid_index(pos)] == arena->generation)
+                {
+                    arena->remove(old_dist, _grid_index(pos));
+                }
+                arena->visited[pos.x][pos.y] = arena->generation;
+                arena->dist[pos.x][pos.y] = distance;
+                arena->push(distance, _grid_index(pos));
+            }
+        }
+    }
+
+    for (int x = 0; x < GXM; x++)
+        for (int y = 0; y < GYM; y++)
+            field.dist[x][y] = dist_at(coord_def(x, y));
+    field.filled = true;
+}
+
+// Walk downhill on the field from start to the target. Returns false if the
+// target is out of reach.
+bool monster_pathfind::path_from_field(const pathfind_field &field)
+{
+    field_path.clear();
+    field_path.push_back(start);
+
+    // As in calc_path_to_neighbours(), prefer orthogonal steps on ties and
+    // pick a random rotation to avoid bias.
+    const int rotate = random2(4) * 2;
+    const int max_dist = range * 2;
+    int remaining = INFINITE_DISTANCE;
+    pos = start;
+    while (pos != target)
+    {
+        coord_def best;
+        int best_dist = INFINITE_DISTANCE;
+        for (int idir = 0; idir < 8; (idir += 2) == 8 && (idir = 1))
+        {
+            const coord_def npos = pos + Compass[(idir + rotate) % 8];
+            if (!in_bounds(npos)
+                || field.dist[npos.x][npos.y] == INFINITE_DISTANCE)
+            {
+                continue;
+            }
+
+            const int distance = field.dist[npos.x][npos.y]
+                                 + travel_cost(npos);
+            if (distance < best_dist)
+            {
+                best = npos;
+                best_dist = distance;
+            }
+        }
+
+        // Nothing reachable, or the path would be longer than the A* search
+        // would accept.
+        if (best_dist == INFINITE_DISTANCE
+            || pos == start && best_dist > max_dist
+            || best_dist > remaining)
+        {
+            field_path.clear();
+            return false;
+        }
+
+        remaining = field.dist[best.x][best.y];
+        pos = best;
+        field_path.push_back(pos);
+    }
+
+    return true;
+}
+
+// Like init_pathfind(mon, dest), but shares the work with other monsters of
+// the same movement class heading for the same target this turn. Only
+// hostile monsters qualify: allies avoid traps and stay in sight, which
+// depends on more than their movement class.
+bool monster_pathfind::init_shared_pathfind(const monster* mon, coord_def dest)
+{
+    if (mon->wont_attack() || mon->type == MONS_THORN_HUNTER || !range)
+        return init_pathfind(mon, dest);
+
+    const pathfind_move_class move_class(*mon);
+    pathfind_field* field = nullptr;
+    for (const auto &f : shared_fields)
+        if (f->matches(move_class, dest, range))
+            field = f.get();
+
+    // The first monster of its class to want this target pathfinds alone.
+    if (!field)
+    {
+        if (shared_fields.size() >= MAX_SHARED_FIELDS)
+            shared_fields.erase(shared_fields.begin());
+        shared_fields.emplace_back(new pathfind_field(move_class, dest,
+                                                      range));
+        return init_pathfind(mon, dest);
+    }
+
+    mons   = mon;
+    start  = mon->pos();
+    target = dest;
+    allow_diagonals   = true;
+    traverse_unmapped = false;
+    traverse_in_sight = false;
+
+    if (start == target)
+        return true;
+
+    if (!field->filled)
+        fill_field(*field);
+
+    return path_from_field(*field);
 }
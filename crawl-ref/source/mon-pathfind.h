@@ -3,15 +3,18 @@
 #include "coord-def.h"
 #include "defines.h"
 #include "fixedvector.h"
-#include "maybe-bool.h"
-#include <unordered_map>
+#include <memory>
 #include <vector>
 
+using std::unique_ptr;
 using std::vector;
 
 class monster;
+struct pathfind_arena;
+struct pathfind_field;
 
 int mons_tracking_range(const monster* mon);
+void invalidate_shared_pathfinding();
 
 class monster_pathfind
 {
@@ -27,6 +30,7 @@ public:
                        bool pass_unmapped = false);
     bool init_pathfind(coord_def src, coord_def dest,
                        bool diag = true, bool msg = false);
+    bool init_shared_pathfind(const monster* mon, coord_def dest);
     bool start_pathfind(bool msg = false);
     vector<coord_def> backtrack();
     vector<coord_def> calc_waypoints();
@@ -43,6 +47,9 @@ protected:
     void add_new_pos(coord_def pos, int total);
     void update_pos(coord_def pos, int total);
     bool get_best_position();
+    int  dist_at(const coord_def& p) const;
+    void fill_field(pathfind_field &field);
+    bool path_from_field(const pathfind_field &field);
 
     // The monster trying to find a path.
     const monster* mons;
@@ -69,12 +76,11 @@ protected:
     int min_length;
     int max_length;
 
-    // The array of distances from start to any already tried point.
-    int dist[GXM][GYM];
-    // An array to store where we came from on a given shortest path.
-    int prev[GXM][GYM];
+    // Distances, backtracking information, the traversability cache and
+    // the queue of open positions. Arenas are reused between searches and
+    // stamped with a generation rather than cleared; see mon-pathfind.cc.
+    unique_ptr<pathfind_arena> arena;
 
-    FixedVector<vector<coord_def>, GXM * GYM> hash;
-
-    maybe_bool traversable_cache[GXM][GYM];
+    // The path found by init_shared_pathfind(), if any.
+    vector<coord_def> field_path;
 };
@@ -3956,12 +3956,21 @@ bool mons_can_destroy_door(const monster& mon, const coord_def& pos)
     return true;
 }
 
+// Can the monster get through closed doors, other than those restricted by
+// a door_restrict marker?
+bool mons_can_pass_doors(const monster& mon)
+{
+    return mon.can_pass_through_feat(DNGN_FLOOR)
+           && (_mons_can_open_doors(&mon) && !mon.friendly()
+               || mons_eats_items(mon)
+               || mons_class_flag(mons_base_type(mon), M_EAT_DOORS)
+               || mons_class_flag(mons_base_type(mon), M_CRASH_DOORS));
+}
+
 static bool _mons_can_pass_door(const monster* mon, const coord_def& pos)
 {
-    return mon->can_pass_through_feat(DNGN_FLOOR)
-           && (mons_can_open_door(*mon, pos)
-               || mons_can_eat_door(*mon, pos)
-               || mons_can_destroy_door(*mon, pos));
+    return mons_can_pass_doors(*mon)
+           && env.markers.property_at(pos, MAT_ANY, "door_restrict") != "veto";
 }
 
 bool mons_can_traverse(const monster& mon, const coord_def& p,
@@ -485,6 +485,7 @@ bool mons_class_can_pass(monster_type mc, const dungeon_feature_type grid);
 bool mons_can_open_door(const monster& mon, const coord_def& pos);
 bool mons_can_eat_door(const monster& mon, const coord_def& pos);
 bool mons_can_destroy_door(const monster& mon, const coord_def& pos);
+bool mons_can_pass_doors(const monster& mon);
 bool mons_can_traverse(const monster& mon, const coord_def& pos,
                        bool only_in_sight = false,
                        bool checktraps = true);
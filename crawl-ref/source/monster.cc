@@ -268,7 +268,11 @@ bool monster::submerged() const
 
 bool monster::extra_balanced_at(const coord_def p) const
 {
-    const dungeon_feature_type grid = env.grid(p);
+    return extra_balanced_in(env.grid(p));
+}
+
+bool monster::extra_balanced_in(dungeon_feature_type grid) const
+{
     return grid == DNGN_SHALLOW_WATER
            && (mons_genus(type) == MONS_NAGA // tails, not feet
                || mons_genus(type) == MONS_SALAMANDER
@@ -291,16 +295,25 @@ bool monster::extra_balanced() const
  */
 bool monster::floundering_at(const coord_def p) const
 {
-    const dungeon_feature_type grid = env.grid(p);
-    return (liquefied(p)
-            || (feat_is_water(grid)
-                // Can't use monster_habitable_grid() because that'll return
-                // true for non-water monsters in shallow water.
-                && mons_primary_habitat(*this) != HT_WATER
-                // Use real_amphibious to detect giant non-water monsters in
-                // deep water, who flounder despite being treated as amphibious.
-                && mons_habitat(*this, true) != HT_AMPHIBIOUS
-                && !extra_balanced_at(p)))
+    return liquefied(p) && ground_level() || floundering_in(env.grid(p));
+}
+
+/**
+ * Would the monster flounder in this terrain, ignoring liquefaction?
+ *
+ * @param grid The terrain feature to check.
+ * @return Whether the monster would be floundering in grid.
+ */
+bool monster::floundering_in(dungeon_feature_type grid) const
+{
+    return feat_is_water(grid)
+           // Can't use monster_habitable_grid() because that'll return
+           // true for non-water monsters in shallow water.
+           && mons_primary_habitat(*this) != HT_WATER
+           // Use real_amphibious to detect giant non-water monsters in
+           // deep water, who flounder despite being treated as amphibious.
+           && mons_habitat(*this, true) != HT_AMPHIBIOUS
+           && !extra_balanced_in(grid)
            && ground_level();
 }
 
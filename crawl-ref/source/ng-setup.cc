@@ -589,6 +589,7 @@ static void _setup_generic(const newgame_def& ng,
     else
         you.save = new package(get_savedir_filename(you.your_name).c_str(),
                                true, true);
+    you.save->set_compression(Options.save_codec, Options.save_compression);
 
     // pregen temple -- it's quick and easy, and this prevents a popup from
     // happening. This needs to happen after you.save is created.
@@ -20,6 +20,7 @@
 #include "mpr.h"
 #include "newgame-def.h"
 #include "pattern.h"
+#include "pkg-codec.h"
 #include "screen-mode.h"
 #include "skill-focus-mode.h"
 #include "slot-select-mode.h"
@@ -331,6 +332,9 @@ public:
     vector<string> terp_files; // Lua files to load for luaterp
     bool           no_save;    // don't use persistent save files
     bool           no_player_bones;   // don't save player's info in bones files
+    pkg_codec      save_codec;
+    int            save_compression;  // 0 for none, or a level (1-9)
+    int            save_compact_slack; // % of holes in the save to compact at
 
     // internal use only:
     int         sc_entries;      // # of score entries
@@ -524,6 +528,8 @@ public:
     string      fsim_mode;
     bool        fsim_csv;
     int         fsim_rounds;
+    int         fsim_precision;
+    int         fsim_jobs;
     string      fsim_mons;
     vector<string> fsim_scale;
     vector<string> fsim_kit;
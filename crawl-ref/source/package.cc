@@ -22,6 +22,7 @@ Notes:
 
 #include "package.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -32,6 +33,9 @@ Notes:
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
 #endif
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "end.h"
 #include "endianness.h"
@@ -59,9 +63,25 @@ static plen_t htole(plen_t x)
 #define dprintf(...) do {} while (0)
 #endif
 
-#define PACKAGE_VERSION 1
+#define PACKAGE_VERSION 2
 #define PACKAGE_MAGIC   0x53534344 /* "DCSS" */
 
+// The directory, and every chunk of a version 0 or 1 package, always use
+// the default codec.
+#ifdef USE_ZLIB
+#define DEFAULT_CODEC   PKG_CODEC_ZLIB
+#else
+#define DEFAULT_CODEC   PKG_CODEC_NONE
+#endif
+#define DEFAULT_LEVEL   -1 /* Z_DEFAULT_COMPRESSION */
+
+// The size of a chunk_writer's output buffer.
+#define ZB_SIZE 32768
+
+// Old copies of moved chunks can only be reused after a commit, so
+// compaction may need a few rounds to settle.
+#define MAX_COMPACT_PASSES 8
+
 struct file_header
 {
     uint32_t magic;
@@ -86,6 +106,11 @@ package::package(const char* file, bool writeable, bool empty)
 #ifdef DO_FSYNC
     , tmp(false)
 #endif
+#ifdef USE_MMAP
+    , mapped(nullptr), map_len(0)
+#endif
+    , codec(DEFAULT_CODEC), compression_level(DEFAULT_LEVEL),
+      pending(nullptr), compacting(false)
 {
     dprintf("package: initializing file=\"%s\" rw=%d\n", file, writeable);
     ASSERT(writeable || !empty);
@@ -136,6 +161,11 @@ package::package()
 #ifdef DO_FSYNC
     , tmp(true)
 #endif
+#ifdef USE_MMAP
+    , mapped(nullptr), map_len(0)
+#endif
+    , codec(DEFAULT_CODEC), compression_level(DEFAULT_LEVEL),
+      pending(nullptr), compacting(false)
 {
     dprintf("package: initializing tmp file\n");
     filename = "[tmp]";
@@ -217,9 +247,18 @@ package::~package()
     if (rw && !aborted)
     {
         commit();
+#ifdef USE_MMAP
+        // Shrinking the file under a mapping would make it unsafe.
+        unmap();
+#endif
         if (ftruncate(fd, file_len))
             sysfail("failed to update save file");
     }
+    // Only left over if we were aborted.
+    drop_pending();
+#ifdef USE_MMAP
+    unmap();
+#endif
 
     // all errors here should be cached write errors
     if (fd != -1)
@@ -234,6 +273,7 @@ package::~package()
 void package::commit()
 {
     ASSERT(rw);
+    flush_pending();
     if (!dirty)
         return;
     ASSERT(!aborted);
@@ -269,6 +309,78 @@ void package::commit()
 #endif
 }
 
+// Rewrite scattered chunks as single blocks, and move chunks into earlier
+// holes they fit in, then give the freed space at the end of the file back.
+// Chunks are copied in their encoded form, so nothing is recompressed.
+void package::compact()
+{
+    ASSERT(rw);
+    ASSERT(!aborted);
+    ASSERT(!n_users);
+
+    commit();
+    load_traces();
+    compacting = true;
+
+    for (int pass = 0; pass < MAX_COMPACT_PASSES; ++pass)
+    {
+        vector<pair<plen_t, string>> chunks;
+        for (const auto &entry : directory)
+            if (!entry.first.empty() && entry.second)
+                chunks.emplace_back(entry.second, entry.first);
+        // Moving the last chunks first frees the end of the file.
+        sort(chunks.rbegin(), chunks.rend());
+
+        bool moved = false;
+        for (const auto &chunk : chunks)
+        {
+            const plen_t start = chunk.first;
+            plen_t len = 0, frags = 0;
+            for (plen_t at = start; at; at = block_map[at].second, ++frags)
+                len += block_map[at].first;
+
+            bool earlier_hole = false;
+            for (auto hole = free_blocks.begin();
+                 hole != free_blocks.end() && hole->first < start; ++hole)
+            {
+                if (hole->second >= len + sizeof(block_header))
+                {
+                    earlier_hole = true;
+                    break;
+                }
+            }
+            if (frags == 1 && !earlier_hole)
+                continue;
+
+            vector<char> data(len);
+            {
+                chunk_reader rd(this, start, PKG_CODEC_NONE);
+                if (rd.raw_read(&data[0], len) != len)
+                    corrupted("save file corrupted -- chunk shorter than its blocks");
+            }
+            const pkg_codec chunk_codec = chunk_codecs[chunk.second];
+            {
+                chunk_writer w(this, chunk.second, PKG_CODEC_NONE, 0);
+                w.write(&data[0], len);
+            }
+            chunk_codecs[chunk.second] = chunk_codec;
+            moved = true;
+        }
+
+        commit();
+        if (!moved)
+            break;
+    }
+
+    compacting = false;
+
+#ifdef USE_MMAP
+    unmap();
+#endif
+    if (ftruncate(fd, file_len))
+        sysfail("failed to update save file");
+}
+
 void package::seek(plen_t to)
 {
     ASSERT(!aborted);
@@ -279,6 +391,55 @@ void package::seek(plen_t to)
         sysfail("failed to seek inside the save file");
 }
 
+// Returns a pointer to the given range of the file, or nullptr if it can't
+// be mapped, in which case the caller must fall back to read().
+const char *package::map_range(plen_t at, plen_t len)
+{
+#ifdef USE_MMAP
+    if (at + len <= map_len)
+        return mapped + at;
+
+    // The file has grown since it was mapped. Only map what has actually
+    // been written: touching a page past the end of the file is fatal.
+    struct stat st;
+    if (fstat(fd, &st) || (off_t)(at + len) > st.st_size)
+        return nullptr;
+
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED)
+        return nullptr;
+
+    // Other readers may still point into the old mapping.
+    if (mapped)
+        stale_maps.emplace_back(mapped, map_len);
+    mapped = (const char *)m;
+    map_len = st.st_size;
+    return mapped + at;
+#else
+    UNUSED(at, len);
+    return nullptr;
+#endif
+}
+
+#ifdef USE_MMAP
+// Only safe once no reader can still point into an older mapping.
+void package::unmap_stale()
+{
+    for (const auto &m : stale_maps)
+        munmap((void *)m.first, m.second);
+    stale_maps.clear();
+}
+
+void package::unmap()
+{
+    unmap_stale();
+    if (mapped)
+        munmap((void *)mapped, map_len);
+    mapped = nullptr;
+    map_len = 0;
+}
+#endif
+
 chunk_writer* package::writer(const string &name)
 {
     return new chunk_writer(this, name);
@@ -286,11 +447,130 @@ chunk_writer* package::writer(const string &name)
 
 chunk_reader* package::reader(const string &name)
 {
+    flush_pending(name);
     if (plen_t *ch = map_find(directory, name))
-        return new chunk_reader(this, *ch);
+        return new chunk_reader(this, *ch, chunk_codecs[name]);
     return 0;
 }
 
+static void *_encode_pending(void *arg)
+{
+    pending_chunk *p = static_cast<pending_chunk *>(arg);
+    vector<unsigned char> out;
+    switch (p->codec)
+    {
+#ifdef USE_ZLIB
+    case PKG_CODEC_ZLIB:
+    {
+        out.resize(compressBound(p->data.size()));
+        uLongf len = out.size();
+        if (compress2(&out[0], &len, p->data.data(), p->data.size(),
+                      p->level) != Z_OK)
+        {
+            p->failed = true;
+            return nullptr;
+        }
+        out.resize(len);
+        break;
+    }
+#endif
+#ifdef USE_ZSTD
+    case PKG_CODEC_ZSTD:
+    {
+        out.resize(ZSTD_compressBound(p->data.size()));
+        const size_t len = ZSTD_compress(&out[0], out.size(), p->data.data(),
+                                         p->data.size(), p->level);
+        if (ZSTD_isError(len))
+        {
+            p->failed = true;
+            return nullptr;
+        }
+        out.resize(len);
+        break;
+    }
+#endif
+    default:
+        die("unexpected codec %d for a pending chunk", p->codec);
+    }
+    p->data.swap(out);
+    return nullptr;
+}
+
+// Store a chunk whose contents are already marshalled, compressing it on
+// another thread. Until the compression is done, the chunk is only held in
+// memory, like any other uncommitted write; the package waits for it before
+// committing or before anything else touches a chunk of that name.
+void package::write_async(const string &name, vector<unsigned char> &&data)
+{
+    ASSERT(rw);
+    ASSERT(!aborted);
+    flush_pending();
+
+    pending = new pending_chunk { name, codec, compression_level, move(data),
+                                  false, thread_t() };
+    if (pending->data.empty() || codec == PKG_CODEC_NONE
+        || thread_create_joinable(&pending->worker, _encode_pending, pending))
+    {
+        // Nothing to gain from a thread, or we couldn't start one.
+        pending_chunk p = move(*pending);
+        delete pending;
+        pending = nullptr;
+
+        chunk_writer w(this, p.name, p.codec, p.level);
+        if (!p.data.empty())
+            w.write(&p.data[0], p.data.size());
+    }
+}
+
+void package::flush_pending()
+{
+    if (!pending)
+        return;
+
+    thread_join(pending->worker);
+    pending_chunk p = move(*pending);
+    delete pending;
+    pending = nullptr;
+
+    if (p.failed)
+        fail("save file compression failed for \"%s\"", p.name.c_str());
+
+    // The data is already encoded, so write it out as is and label it.
+    {
+        chunk_writer w(this, p.name, PKG_CODEC_NONE, 0);
+        w.write(&p.data[0], p.data.size());
+    }
+    chunk_codecs[p.name] = p.codec;
+}
+
+void package::flush_pending(const string &name)
+{
+    if (pending && pending->name == name)
+        flush_pending();
+}
+
+void package::drop_pending()
+{
+    if (!pending)
+        return;
+    thread_join(pending->worker);
+    delete pending;
+    pending = nullptr;
+}
+
+void package::set_compression(pkg_codec new_codec, int level)
+{
+    ASSERT(level >= 0 && level <= 9);
+    codec = level ? new_codec : PKG_CODEC_NONE;
+    compression_level = level;
+#ifndef USE_ZLIB
+    ASSERT(codec != PKG_CODEC_ZLIB);
+#endif
+#ifndef USE_ZSTD
+    ASSERT(codec != PKG_CODEC_ZSTD);
+#endif
+}
+
 plen_t package::extend_block(plen_t at, plen_t size, plen_t by)
 {
     // the header is not counted into the block's size, yet takes space
@@ -324,6 +604,26 @@ plen_t package::extend_block(plen_t at, plen_t size, plen_t by)
 
 plen_t package::alloc_block(plen_t &size)
 {
+    if (compacting)
+    {
+        // Take the first hole the whole block fits in, or else the end of
+        // the file; never split the block.
+        for (auto hole = free_blocks.begin(); hole != free_blocks.end(); ++hole)
+        {
+            if (hole->second < size + sizeof(block_header))
+                continue;
+            plen_t at = hole->first;
+            plen_t rest = hole->second - size - sizeof(block_header);
+            free_blocks.erase(hole);
+            if (rest)
+                free_blocks[at + sizeof(block_header) + size] = rest;
+            return at;
+        }
+        plen_t at = file_len;
+        file_len += sizeof(block_header) + size;
+        return at;
+    }
+
     fb_t::iterator bl, best_big, best_small;
     plen_t bb_size = (plen_t)-1, bs_size = 0;
     for (bl = free_blocks.begin(); bl!=free_blocks.end(); ++bl)
@@ -359,10 +659,12 @@ plen_t package::alloc_block(plen_t &size)
     return at;
 }
 
-void package::finish_chunk(const string &name, plen_t at)
+void package::finish_chunk(const string &name, plen_t at,
+                           pkg_codec chunk_codec)
 {
     free_chunk(name);
     directory[name] = at;
+    chunk_codecs[name] = chunk_codec;
     new_chunks.insert(at);
     dirty = true;
 }
@@ -384,8 +686,10 @@ void package::free_chunk(const string &name)
 
 void package::delete_chunk(const string &name)
 {
+    flush_pending(name);
     free_chunk(name);
     directory.erase(name);
+    chunk_codecs.erase(name);
 }
 
 plen_t package::write_directory()
@@ -400,12 +704,15 @@ plen_t package::write_directory()
         dir.write(&entry.first[0], entry.first.length());
         plen_t start = htole(entry.second);
         dir.write((const char*)&start, sizeof(plen_t));
+        const pkg_codec *chunk_codec = map_find(chunk_codecs, entry.first);
+        ASSERT(chunk_codec);
+        dir.write((const char*)chunk_codec, sizeof(*chunk_codec));
     }
 
     ASSERT(dir.str().size());
     dprintf("writing directory (%u bytes)\n", (unsigned int)dir.str().size());
     {
-        chunk_writer dch(this, "");
+        chunk_writer dch(this, "", DEFAULT_CODEC, DEFAULT_LEVEL);
         dch.write(&dir.str()[0], dir.str().size());
     }
 
@@ -521,9 +828,10 @@ void package::read_directory(plen_t start, uint8_t version)
 {
     ASSERT(directory.empty());
     directory[""] = start;
+    chunk_codecs[""] = DEFAULT_CODEC;
 
     dprintf("package: reading directory\n");
-    chunk_reader rd(this, start);
+    chunk_reader rd(this, start, DEFAULT_CODEC);
 
     switch (version)
     {
@@ -536,12 +844,15 @@ void package::read_directory(plen_t start, uint8_t version)
             string chname(ch0.name, 4);
             chname.resize(strlen(chname.c_str()));
             directory[chname] = htole(ch0.start);
+            chunk_codecs[chname] = DEFAULT_CODEC;
             dprintf("* %s\n", chname.c_str());
         }
         break;
     case 1:
+    case 2:
         uint8_t name_len;
         plen_t bstart;
+        uint8_t chunk_codec;
         while (plen_t res = rd.read(&name_len, sizeof(name_len)))
         {
             if (res != sizeof(name_len))
@@ -552,7 +863,20 @@ void package::read_directory(plen_t start, uint8_t version)
                 corrupted("save file corrupted -- truncated directory");
             if (rd.read(&bstart, sizeof(bstart)) != sizeof(bstart))
                 corrupted("save file corrupted -- truncated directory");
+            chunk_codec = DEFAULT_CODEC;
+            if (version >= 2
+                && rd.read(&chunk_codec, sizeof(chunk_codec))
+                   != sizeof(chunk_codec))
+            {
+                corrupted("save file corrupted -- truncated directory");
+            }
+            if (chunk_codec >= NUM_PKG_CODECS)
+            {
+                corrupted("save file (%s) uses an unknown codec %u",
+                          filename.c_str(), chunk_codec);
+            }
             directory[chname] = htole(bstart);
+            chunk_codecs[chname] = static_cast<pkg_codec>(chunk_codec);
             dprintf("* %s\n", chname.c_str());
         }
         break;
@@ -564,11 +888,13 @@ void package::read_directory(plen_t start, uint8_t version)
 
 bool package::has_chunk(const string &name)
 {
+    flush_pending(name);
     return !name.empty() && directory.count(name);
 }
 
 vector<string> package::list_chunks()
 {
+    flush_pending();
     vector<string> list;
     list.reserve(directory.size());
     for (const auto &entry : directory)
@@ -620,11 +946,15 @@ void package::abort()
     // this point are ignored (assuming we already failed). All writes since
     // the last commit() are lost.
     aborted = true;
+    drop_pending();
 }
 
 void package::unlink()
 {
     abort();
+#ifdef USE_MMAP
+    unmap();
+#endif
     close(fd);
     fd = -1;
     ::unlink_u(filename.c_str());
@@ -633,6 +963,7 @@ void package::unlink()
 // the amount of free space not at the end of file
 plen_t package::get_slack()
 {
+    flush_pending();
     load_traces();
 
     plen_t slack = 0;
@@ -643,6 +974,7 @@ plen_t package::get_slack()
 
 plen_t package::get_chunk_fragmentation(const string &name)
 {
+    flush_pending();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t frags = 0;
@@ -657,8 +989,16 @@ plen_t package::get_chunk_fragmentation(const string &name)
     return frags;
 }
 
+pkg_codec package::get_chunk_codec(const string &name)
+{
+    flush_pending(name);
+    ASSERT(directory.count(name)); // not has_chunk(), "" is valid
+    return chunk_codecs[name];
+}
+
 plen_t package::get_chunk_compressed_length(const string &name)
 {
+    flush_pending();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t len = 0;
@@ -674,7 +1014,15 @@ plen_t package::get_chunk_compressed_length(const string &name)
 }
 
 chunk_writer::chunk_writer(package *parent, const string &_name)
-    : first_block(0), cur_block(0), block_len(0)
+    : chunk_writer(parent, _name, parent->codec, parent->compression_level)
+{
+    // An older pending write of this chunk mustn't land on top of ours.
+    pkg->flush_pending(_name);
+}
+
+chunk_writer::chunk_writer(package *parent, const string &_name,
+                           pkg_codec _codec, int level)
+    : first_block(0), cur_block(0), block_len(0), codec(_codec)
 {
     ASSERT(parent);
     ASSERT(!parent->aborted);
@@ -689,16 +1037,39 @@ chunk_writer::chunk_writer(package *parent, const string &_name)
     name = _name;
 
 #ifdef USE_ZLIB
-    zs.data_type = Z_BINARY;
-    zs.zalloc    = 0;
-    zs.zfree     = 0;
-    zs.opaque    = Z_NULL;
-    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
-        fail("save file compression failed during init: %s", zs.msg);
-#define ZB_SIZE 32768
-    zs.next_out  = z_buffer = (Bytef*)malloc(ZB_SIZE);
-    zs.avail_out = ZB_SIZE;
+    if (codec == PKG_CODEC_ZLIB)
+    {
+        zs.data_type = Z_BINARY;
+        zs.zalloc    = 0;
+        zs.zfree     = 0;
+        zs.opaque    = Z_NULL;
+        if (deflateInit(&zs, level))
+            fail("save file compression failed during init: %s", zs.msg);
+        zs.next_out  = z_buffer = (unsigned char*)malloc(ZB_SIZE);
+        zs.avail_out = ZB_SIZE;
+    }
+#else
+    ASSERT(codec != PKG_CODEC_ZLIB);
 #endif
+#ifdef USE_ZSTD
+    if (codec == PKG_CODEC_ZSTD)
+    {
+        zc = ZSTD_createCCtx();
+        if (!zc)
+            fail("save file compression failed during init");
+        const size_t res = ZSTD_CCtx_setParameter(zc, ZSTD_c_compressionLevel,
+                                                  level);
+        if (ZSTD_isError(res))
+        {
+            fail("save file compression failed during init: %s",
+                 ZSTD_getErrorName(res));
+        }
+        z_buffer = (unsigned char*)malloc(ZB_SIZE);
+    }
+#else
+    ASSERT(codec != PKG_CODEC_ZSTD);
+#endif
+    UNUSED(level);
 }
 
 chunk_writer::~chunk_writer()
@@ -710,32 +1081,53 @@ chunk_writer::~chunk_writer()
     if (pkg->aborted)
     {
 #ifdef USE_ZLIB
-        // ignore errors, they're not relevant anymore
-        deflateEnd(&zs);
-        free(z_buffer);
+        if (codec == PKG_CODEC_ZLIB)
+        {
+            // ignore errors, they're not relevant anymore
+            deflateEnd(&zs);
+            free(z_buffer);
+        }
+#endif
+#ifdef USE_ZSTD
+        if (codec == PKG_CODEC_ZSTD)
+        {
+            ZSTD_freeCCtx(zc);
+            free(z_buffer);
+        }
 #endif
         return;
     }
 
 #ifdef USE_ZLIB
-    zs.avail_in = 0;
-    int res;
-    do
+    if (codec == PKG_CODEC_ZLIB)
     {
-        res = deflate(&zs, Z_FINISH);
-        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
-            fail("save file compression failed: %s", zs.msg);
-        raw_write(z_buffer, zs.next_out - z_buffer);
-        zs.next_out = z_buffer;
-        zs.avail_out = ZB_SIZE;
-    } while (res != Z_STREAM_END);
-    if (deflateEnd(&zs) != Z_OK)
-        fail("save file compression failed during clean-up: %s", zs.msg);
-    free(z_buffer);
+        zs.avail_in = 0;
+        int res;
+        do
+        {
+            res = deflate(&zs, Z_FINISH);
+            if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
+                fail("save file compression failed: %s", zs.msg);
+            raw_write(z_buffer, zs.next_out - z_buffer);
+            zs.next_out = z_buffer;
+            zs.avail_out = ZB_SIZE;
+        } while (res != Z_STREAM_END);
+        if (deflateEnd(&zs) != Z_OK)
+            fail("save file compression failed during clean-up: %s", zs.msg);
+        free(z_buffer);
+    }
+#endif
+#ifdef USE_ZSTD
+    if (codec == PKG_CODEC_ZSTD)
+    {
+        zstd_write(nullptr, 0, true);
+        ZSTD_freeCCtx(zc);
+        free(z_buffer);
+    }
 #endif
     if (cur_block)
         finish_block(0);
-    pkg->finish_chunk(name, first_block);
+    pkg->finish_chunk(name, first_block, codec);
 }
 
 void chunk_writer::raw_write(const void *data, plen_t len)
@@ -764,6 +1156,25 @@ void chunk_writer::raw_write(const void *data, plen_t len)
     }
 }
 
+#ifdef USE_ZSTD
+// Feed data to the zstd stream, writing out whatever it produces; if finish
+// is set, also end the frame.
+void chunk_writer::zstd_write(const void *data, plen_t len, bool finish)
+{
+    ZSTD_inBuffer in = { data, len, 0 };
+    size_t left;
+    do
+    {
+        ZSTD_outBuffer out = { z_buffer, ZB_SIZE, 0 };
+        left = ZSTD_compressStream2(zc, &out, &in,
+                                    finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(left))
+            fail("save file compression failed: %s", ZSTD_getErrorName(left));
+        raw_write(z_buffer, out.pos);
+    } while (finish ? left : in.pos < in.size);
+}
+#endif
+
 void chunk_writer::finish_block(plen_t next)
 {
     block_header head;
@@ -783,54 +1194,88 @@ void chunk_writer::write(const void *data, plen_t len)
     ASSERT(!pkg->aborted);
 
 #ifdef USE_ZLIB
-    zs.next_in  = (Bytef*)data;
-    zs.avail_in = len;
-    while (zs.avail_in)
+    if (codec == PKG_CODEC_ZLIB)
     {
-        if (!zs.avail_out)
+        zs.next_in  = (Bytef*)data;
+        zs.avail_in = len;
+        while (zs.avail_in)
         {
-            raw_write(z_buffer, zs.next_out - z_buffer);
-            zs.next_out  = z_buffer;
-            zs.avail_out = ZB_SIZE;
+            if (!zs.avail_out)
+            {
+                raw_write(z_buffer, zs.next_out - z_buffer);
+                zs.next_out  = z_buffer;
+                zs.avail_out = ZB_SIZE;
+            }
+            // we don't allow Z_BUF_ERROR, so it's fatal for us
+            if (deflate(&zs, Z_NO_FLUSH) != Z_OK)
+                fail("save file compression failed: %s", zs.msg);
         }
-        // we don't allow Z_BUF_ERROR, so it's fatal for us
-        if (deflate(&zs, Z_NO_FLUSH) != Z_OK)
-            fail("save file compression failed: %s", zs.msg);
+        return;
     }
-#else
-    raw_write(data, len);
 #endif
+#ifdef USE_ZSTD
+    if (codec == PKG_CODEC_ZSTD)
+    {
+        zstd_write(data, len, false);
+        return;
+    }
+#endif
+    raw_write(data, len);
 }
 
-void chunk_reader::init(plen_t start)
+void chunk_reader::init(plen_t start, pkg_codec _codec)
 {
     ASSERT(!pkg->aborted);
     pkg->n_users++;
     pkg->reader_count[start]++;
     first_block = next_block = start;
     block_left = 0;
+    codec = _codec;
 
+    if (codec == PKG_CODEC_ZLIB)
+    {
 #ifdef USE_ZLIB
-    if (!start)
-        corrupted("save file corrupted -- zlib header missing");
-
-    zs.zalloc    = 0;
-    zs.zfree     = 0;
-    zs.opaque    = Z_NULL;
-    zs.next_in   = Z_NULL;
-    zs.avail_in  = 0;
-    if (inflateInit(&zs))
-        fail("save file decompression failed during init: %s", zs.msg);
-    eof = false;
+        if (!start)
+            corrupted("save file corrupted -- zlib header missing");
+
+        zs.zalloc    = 0;
+        zs.zfree     = 0;
+        zs.opaque    = Z_NULL;
+        zs.next_in   = Z_NULL;
+        zs.avail_in  = 0;
+        if (inflateInit(&zs))
+            fail("save file decompression failed during init: %s", zs.msg);
+        eof = false;
+#else
+        corrupted("save file uses compression, but this build has no zlib");
 #endif
+    }
+    else if (codec == PKG_CODEC_ZSTD)
+    {
+#ifdef USE_ZSTD
+        if (!start)
+            corrupted("save file corrupted -- zstd frame missing");
+
+        zd = ZSTD_createDCtx();
+        if (!zd)
+            fail("save file decompression failed during init");
+        zin.src  = nullptr;
+        zin.size = 0;
+        zin.pos  = 0;
+        eof = false;
+#else
+        corrupted("save file uses zstd compression, but this build has no "
+                  "zstd support");
+#endif
+    }
 }
 
-chunk_reader::chunk_reader(package *parent, plen_t start)
+chunk_reader::chunk_reader(package *parent, plen_t start, pkg_codec _codec)
 {
     ASSERT(parent);
     dprintf("chunk_reader[%u]: starting\n", start);
     pkg = parent;
-    init(start);
+    init(start, _codec);
 }
 
 chunk_reader::chunk_reader(package *parent, const string &_name)
@@ -840,7 +1285,7 @@ chunk_reader::chunk_reader(package *parent, const string &_name)
         corrupted("save file corrupted -- chunk \"%s\" missing", _name.c_str());
     dprintf("chunk_reader(%s): starting\n", _name.c_str());
     pkg = parent;
-    init(parent->directory[_name]);
+    init(parent->directory[_name], parent->chunk_codecs[_name]);
 }
 
 chunk_reader::~chunk_reader()
@@ -848,52 +1293,77 @@ chunk_reader::~chunk_reader()
     dprintf("chunk_reader: closing\n");
 
 #ifdef USE_ZLIB
-    if (inflateEnd(&zs) != Z_OK)
+    if (codec == PKG_CODEC_ZLIB && inflateEnd(&zs) != Z_OK)
         fail("save file decompression failed during clean-up: %s", zs.msg);
+#endif
+#ifdef USE_ZSTD
+    if (codec == PKG_CODEC_ZSTD)
+        ZSTD_freeDCtx(zd);
 #endif
     ASSERT(pkg->reader_count[first_block] > 0);
     if (!--pkg->reader_count[first_block])
         pkg->reader_count.erase(first_block);
+#ifdef USE_MMAP
+    if (pkg->reader_count.empty())
+        pkg->unmap_stale();
+#endif
     ASSERT(pkg->n_users > 0);
     pkg->n_users--;
 }
 
+// Move on to the next block if the current one is used up. Returns false
+// at the end of the chunk.
+bool chunk_reader::start_block()
+{
+    if (block_left)
+        return true;
+    if (!next_block)
+        return false;
+
+    block_header bl;
+    if (const char *m = pkg->map_range(next_block, sizeof(block_header)))
+        memcpy(&bl, m, sizeof(block_header));
+    else
+    {
+        pkg->seek(next_block);
+        ssize_t res = ::read(pkg->fd, &bl, sizeof(block_header));
+        if (res < 0)
+            sysfail("error reading the save file");
+        if (res != sizeof(block_header))
+            corrupted("save file corrupted -- block past eof");
+    }
+
+    off = next_block + sizeof(block_header);
+    block_left = htole(bl.len);
+    next_block = htole(bl.next);
+    // This reeks of on-disk corruption (zeroed data).
+    if (!block_left)
+        corrupted("save file corrupted -- empty block");
+    return true;
+}
+
 plen_t chunk_reader::raw_read(void *data, plen_t len)
 {
     void *buf = data;
     while (len)
     {
-        if (!block_left)
-        {
-            if (!next_block)
-                return (char*)buf - (char*)data;
+        if (!start_block())
+            return (char*)buf - (char*)data;
 
-            block_header bl;
-            pkg->seek(next_block);
-            ssize_t res = ::read(pkg->fd, &bl, sizeof(block_header));
+        plen_t s = len;
+        if (s > block_left)
+            s = block_left;
+        if (const char *m = pkg->map_range(off, s))
+            memcpy(buf, m, s);
+        else
+        {
+            pkg->seek(off);
+            ssize_t res = ::read(pkg->fd, buf, s);
             if (res < 0)
                 sysfail("error reading the save file");
-            if (res != sizeof(block_header))
+            if ((plen_t)res != s)
                 corrupted("save file corrupted -- block past eof");
-
-            off = next_block + sizeof(block_header);
-            block_left = htole(bl.len);
-            next_block = htole(bl.next);
-            // This reeks of on-disk corruption (zeroed data).
-            if (!block_left)
-                corrupted("save file corrupted -- empty block");
         }
-        else
-            pkg->seek(off);
-
-        plen_t s = len;
-        if (s > block_left)
-            s = block_left;
-        ssize_t res = ::read(pkg->fd, buf, s);
-        if (res < 0)
-            sysfail("error reading the save file");
-        if ((plen_t)res != s)
-            corrupted("save file corrupted -- block past eof");
 
         buf = (char*)buf + s;
         off += s;
@@ -904,6 +1374,28 @@ plen_t chunk_reader::raw_read(void *data, plen_t len)
     return (char*)buf - (char*)data;
 }
 
+// Point data at the rest of the current block inside the mapped file,
+// without copying it. Returns false if the file can't be mapped; len is
+// 0 at the end of the chunk.
+bool chunk_reader::raw_span(const void *&data, plen_t &len)
+{
+    if (!start_block())
+    {
+        len = 0;
+        return true;
+    }
+
+    const char *m = pkg->map_range(off, block_left);
+    if (!m)
+        return false;
+
+    data = m;
+    len = block_left;
+    off += block_left;
+    block_left = 0;
+    return true;
+}
+
 plen_t chunk_reader::read(void *data, plen_t len)
 {
     ASSERT(data);
@@ -911,35 +1403,92 @@ plen_t chunk_reader::read(void *data, plen_t len)
         return 0;
 
 #ifdef USE_ZLIB
-    if (!len)
-        return 0;
-    if (eof)
-        return 0;
-
-    zs.next_out  = (Bytef*)data;
-    zs.avail_out = len;
-    while (zs.avail_out)
+    if (codec == PKG_CODEC_ZLIB)
     {
-        if (!zs.avail_in)
+        if (!len)
+            return 0;
+        if (eof)
+            return 0;
+
+        zs.next_out  = (Bytef*)data;
+        zs.avail_out = len;
+        while (zs.avail_out)
         {
-            zs.next_in  = z_buffer;
-            zs.avail_in = raw_read(z_buffer, sizeof(z_buffer));
             if (!zs.avail_in)
-                corrupted("save file corrupted -- block truncated");
+            {
+                const void *span;
+                plen_t span_len;
+                if (raw_span(span, span_len))
+                {
+                    // inflate straight from the mapping
+                    zs.next_in  = (Bytef*)span;
+                    zs.avail_in = span_len;
+                }
+                else
+                {
+                    zs.next_in  = z_buffer;
+                    zs.avail_in = raw_read(z_buffer, sizeof(z_buffer));
+                }
+                if (!zs.avail_in)
+                    corrupted("save file corrupted -- block truncated");
+            }
+            int res = inflate(&zs, Z_NO_FLUSH);
+            if (res == Z_STREAM_END)
+            {
+                eof = true;
+                return zs.next_out - (Bytef*)data;
+            }
+            if (res != Z_OK)
+                corrupted("save file decompression failed: %s", zs.msg);
         }
-        int res = inflate(&zs, Z_NO_FLUSH);
-        if (res == Z_STREAM_END)
+        return zs.next_out - (Bytef*)data;
+    }
+#endif
+#ifdef USE_ZSTD
+    if (codec == PKG_CODEC_ZSTD)
+    {
+        if (!len || eof)
+            return 0;
+
+        ZSTD_outBuffer out = { data, len, 0 };
+        while (out.pos < out.size)
         {
-            eof = true;
-            return zs.next_out - (Bytef*)data;
+            if (zin.pos == zin.size)
+            {
+                const void *span;
+                plen_t span_len;
+                if (raw_span(span, span_len))
+                {
+                    // decompress straight from the mapping
+                    zin.src  = span;
+                    zin.size = span_len;
+                }
+                else
+                {
+                    zin.src  = z_buffer;
+                    zin.size = raw_read(z_buffer, sizeof(z_buffer));
+                }
+                zin.pos = 0;
+                if (!zin.size)
+                    corrupted("save file corrupted -- block truncated");
+            }
+            const size_t res = ZSTD_decompressStream(zd, &out, &zin);
+            if (ZSTD_isError(res))
+            {
+                corrupted("save file decompression failed: %s",
+                          ZSTD_getErrorName(res));
+            }
+            if (!res)
+            {
+                // the frame is complete and flushed
+                eof = true;
+                break;
+            }
         }
-        if (res != Z_OK)
-            corrupted("save file decompression failed: %s", zs.msg);
+        return out.pos;
     }
-    return zs.next_out - (Bytef*)data;
-#else
-    return raw_read(data, len);
 #endif
+    return raw_read(data, len);
 }
 
 void chunk_reader::read_all(vector<char> &data)
@@ -9,6 +9,12 @@
 #ifdef USE_ZLIB
 #include <zlib.h>
 #endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "pkg-codec.h"
+#include "threads.h"
 
 using std::map;
 using std::pair;
@@ -20,12 +26,30 @@ using std::vector;
 #define DO_FSYNC
 #endif
 
+// Read chunks straight out of a memory mapping of the save, rather than
+// with a seek and a read() for every piece of every block.
+#ifdef UNIX
+#define USE_MMAP
+#endif
+
 #define MAX_CHUNK_NAME_LENGTH 255
 
 typedef uint32_t plen_t;
 
 class package;
 
+// A chunk handed to package::write_async(), being compressed by a worker
+// thread.
+struct pending_chunk
+{
+    string name;
+    pkg_codec codec;
+    int level;
+    vector<unsigned char> data; // replaced by the encoded form when done
+    bool failed;
+    thread_t worker;
+};
+
 class chunk_writer
 {
 private:
@@ -34,12 +58,21 @@ private:
     plen_t first_block;
     plen_t cur_block;
     plen_t block_len;
+    pkg_codec codec;
 #ifdef USE_ZLIB
     z_stream zs;
-    Bytef *z_buffer;
 #endif
+#ifdef USE_ZSTD
+    ZSTD_CCtx *zc;
+#endif
+    unsigned char *z_buffer;
     void raw_write(const void *data, plen_t len);
+#ifdef USE_ZSTD
+    void zstd_write(const void *data, plen_t len, bool finish);
+#endif
     void finish_block(plen_t next);
+    chunk_writer(package *parent, const string &_name, pkg_codec _codec,
+                 int level);
 public:
     chunk_writer(package *parent, const string &_name);
     ~chunk_writer();
@@ -50,17 +83,24 @@ public:
 class chunk_reader
 {
 private:
-    chunk_reader(package *parent, plen_t start);
-    void init(plen_t start);
+    chunk_reader(package *parent, plen_t start, pkg_codec _codec);
+    void init(plen_t start, pkg_codec _codec);
     package *pkg;
     plen_t first_block, next_block;
     plen_t off, block_left;
-#ifdef USE_ZLIB
+    pkg_codec codec;
     bool eof;
+#ifdef USE_ZLIB
     z_stream zs;
-    Bytef z_buffer[32768];
 #endif
+#ifdef USE_ZSTD
+    ZSTD_DCtx *zd;
+    ZSTD_inBuffer zin;
+#endif
+    unsigned char z_buffer[32768];
+    bool start_block();
     plen_t raw_read(void *data, plen_t len);
+    bool raw_span(const void *&data, plen_t &len);
 public:
     chunk_reader(package *parent, const string &_name);
     ~chunk_reader();
@@ -77,19 +117,25 @@ public:
     ~package();
     chunk_writer* writer(const string &name);
     chunk_reader* reader(const string &name);
+    void write_async(const string &name, vector<unsigned char> &&data);
     void commit();
+    void compact();
     void delete_chunk(const string &name);
     bool has_chunk(const string &name);
     vector<string> list_chunks();
     void abort();
     void unlink();
     string get_filename() { return filename; }
+    // Level 0 stores new chunks uncompressed; 1-9 go from fastest to
+    // smallest.
+    void set_compression(pkg_codec new_codec, int level);
 
     // statistics
     plen_t get_slack();
     plen_t get_size() const { return file_len; };
     plen_t get_chunk_fragmentation(const string &name);
     plen_t get_chunk_compressed_length(const string &name);
+    pkg_codec get_chunk_codec(const string &name);
 private:
     string filename;
     bool rw;
@@ -100,8 +146,23 @@ private:
     bool aborted;
 #ifdef DO_FSYNC
     bool tmp;
+#endif
+#ifdef USE_MMAP
+    const char *mapped;
+    plen_t map_len;
+    vector<pair<const char *, plen_t> > stale_maps;
+    void unmap_stale();
+    void unmap();
 #endif
     map<string, plen_t> directory;
+    map<string, pkg_codec> chunk_codecs;
+    pkg_codec codec;
+    int compression_level;
+    pending_chunk *pending;
+    bool compacting;
+    void flush_pending();
+    void flush_pending(const string &name);
+    void drop_pending();
     map<plen_t, plen_t> free_blocks;
     vector<plen_t> unlinked_blocks;
     map<plen_t, pair<plen_t, plen_t> > block_map;
@@ -109,13 +170,14 @@ private:
     map<plen_t, uint32_t> reader_count;
     plen_t extend_block(plen_t at, plen_t size, plen_t by);
     plen_t alloc_block(plen_t &size);
-    void finish_chunk(const string &name, plen_t at);
+    void finish_chunk(const string &name, plen_t at, pkg_codec chunk_codec);
     void free_chunk(const string &name);
     plen_t write_directory();
     void collect_blocks();
     void free_block_chain(plen_t at);
     void free_block(plen_t at, plen_t size);
     void seek(plen_t to);
+    const char *map_range(plen_t at, plen_t len);
     void fsck();
     void read_directory(plen_t start, uint8_t version);
     void trace_chunk(plen_t start);
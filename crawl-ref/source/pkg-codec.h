@@ -0,0 +1,11 @@
+#pragma once
+
+// How a chunk's data is encoded on disk. This is recorded for every chunk
+// in the directory, so chunks written with different settings can coexist.
+enum pkg_codec : uint8_t
+{
+    PKG_CODEC_NONE,             // stored as is
+    PKG_CODEC_ZLIB,             // a zlib stream, at any compression level
+    PKG_CODEC_ZSTD,             // a zstd frame; needs a USE_ZSTD build
+    NUM_PKG_CODECS,
+};
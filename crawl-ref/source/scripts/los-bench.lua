@@ -0,0 +1,86 @@
+-- Benchmarks the global LOS cache under local terrain changes.
+--
+-- On generated levels (the same depths used by test/los_csc.lua), flips
+-- random cells between wall and floor and queries cell_see_cell around
+-- each change. Runs once letting the cache invalidate only the pairs
+-- affected by the change, and once wiping the whole cache after every
+-- change, and reports the time taken and cache hit rate of each.
+--
+-- Usage: crawl -script los-bench [<changes per level>]
+
+local args = script.simple_args()
+local nchanges = tonumber(args[1] or 200)
+local query_radius = 7
+
+local rock_wall = dgn.fnum("rock_wall")
+local floor = dgn.fnum("floor")
+
+local function query_around(x, y)
+  local seen = 0
+  for dy = -query_radius, query_radius do
+    for dx = -query_radius, query_radius do
+      local px, py = x + dx, y + dy
+      if dgn.in_bounds(px, py) and los.cell_see_cell(x, y, px, py) then
+        seen = seen + 1
+      end
+    end
+  end
+  return seen
+end
+
+-- Returns the time taken and a checksum of the visibility results, so that
+-- both modes can be checked to agree.
+local function run_changes(seed, full_invalidate)
+  math.randomseed(seed)
+  los.reset_cache_stats()
+  local seen = 0
+  local start = crawl.millis()
+  for i = 1, nchanges do
+    local x = math.random(1, dgn.GXM - 2)
+    local y = math.random(1, dgn.GYM - 2)
+    local old = dgn.grid(x, y)
+    if old == floor or old == rock_wall then
+      local new = old == floor and rock_wall or floor
+      for _, feat in ipairs({ new, old }) do
+        dgn.terrain_changed(x, y, feat, false, false)
+        if full_invalidate then
+          debug.los_changed()
+        end
+        local qx = math.random(1, dgn.GXM - 2)
+        local qy = math.random(1, dgn.GYM - 2)
+        seen = seen + query_around(x, y) + query_around(qx, qy)
+      end
+    end
+  end
+  return crawl.millis() - start, seen
+end
+
+local function hit_rate()
+  local stats = los.cache_stats()
+  local total = stats.hits + stats.misses
+  return total > 0 and 100 * stats.hits / total or 0
+end
+
+local total_incr, total_full = 0, 0
+for depth = 1, 15 do
+  debug.goto_place("D:" .. depth)
+  test.regenerate_level()
+  debug.los_changed()
+
+  local seed = depth * 7919
+  local incr, seen_incr = run_changes(seed, false)
+  local incr_hits = hit_rate()
+  local full, seen_full = run_changes(seed, true)
+  local full_hits = hit_rate()
+  assert(seen_incr == seen_full,
+         "LOS results differ between invalidation modes on D:" .. depth)
+
+  crawl.stderr(string.format("D:%-2d incremental: %6d ms (%5.1f%% hits)"
+                             .. "  full: %6d ms (%5.1f%% hits)",
+                             depth, incr, incr_hits, full, full_hits))
+  total_incr = total_incr + incr
+  total_full = total_full + full
+end
+
+crawl.stderr(string.format("Total incremental: %d ms  full: %d ms",
+                           total_incr, total_full))
@@ -0,0 +1,32 @@
+-- Benchmarks level marshalling.
+--
+-- For each place, generates a level, then marshalls it into an uncompressed
+-- chunk of a scratch save and reads it back in a number of times, reporting
+-- the size of the marshalled level and the time spent writing and reading
+-- it.
+--
+-- Usage: crawl -script marshall-bench [<iterations>] [<place> ...]
+
+local args = script.simple_args()
+local iterations = 200
+if args[1] and tonumber(args[1]) then
+  iterations = tonumber(table.remove(args, 1))
+end
+local places = #args > 0 and args or { "D:3", "D:10", "Lair:3", "Elf:2",
+                                        "Vaults:3", "Depths:2" }
+
+local total_write, total_read = 0, 0
+for _, place in ipairs(places) do
+  test.regenerate_level(place)
+
+  local bytes, write_ms, read_ms = debug.marshall_level(iterations)
+  crawl.stderr(string.format("%-10s %7d bytes  write: %6d ms (%7.3f ms/level)"
+                             .. "  read: %6d ms (%7.3f ms/level)",
+                             place, bytes, write_ms, write_ms / iterations,
+                             read_ms, read_ms / iterations))
+  total_write = total_write + write_ms
+  total_read = total_read + read_ms
+end
+
+crawl.stderr(string.format("Total write: %d ms  read: %d ms",
+                           total_write, total_read))
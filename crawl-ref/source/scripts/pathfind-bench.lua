@@ -0,0 +1,66 @@
+-- Benchmarks monster pathfinding on generated levels.
+--
+-- For each place, generates a level and runs monster_pathfind from random
+-- monsters on it to random floor cells, then reports the number of paths
+-- computed per second.
+--
+-- Usage: crawl -script pathfind-bench [<paths per level>] [<place> ...]
+
+local args = script.simple_args()
+local npaths = 1000
+if args[1] and tonumber(args[1]) then
+  npaths = tonumber(table.remove(args, 1))
+end
+local places = #args > 0 and args or { "D:3", "D:10", "Lair:3", "Elf:2",
+                                        "Vaults:3", "Depths:2" }
+
+local floor = dgn.fnum("floor")
+
+local function random_floor()
+  while true do
+    local x = crawl.random_range(1, dgn.GXM - 2)
+    local y = crawl.random_range(1, dgn.GYM - 2)
+    if dgn.grid(x, y) == floor then
+      return x, y
+    end
+  end
+end
+
+local total_paths, total_ms = 0, 0
+for _, place in ipairs(places) do
+  test.regenerate_level(place)
+
+  local monsters = { }
+  for mons in test.level_monster_iterator() do
+    table.insert(monsters, mons)
+  end
+
+  if #monsters == 0 then
+    crawl.stderr(place .. ": no monsters, skipping")
+  else
+    local found, steps = 0, 0
+    local start = crawl.millis()
+    for i = 1, npaths do
+      local mons = monsters[crawl.random_range(1, #monsters)]
+      local len = mons.path_to(random_floor())
+      if len then
+        found = found + 1
+        steps = steps + len
+      end
+    end
+    local ms = math.max(crawl.millis() - start, 1)
+
+    crawl.stderr(string.format("%-10s %5d paths (%d found, avg %.1f steps)"
+                               .. " in %5d ms: %8.1f paths/s",
+                               place, npaths, found,
+                               found > 0 and steps / found or 0,
+                               ms, npaths * 1000 / ms))
+    total_paths = total_paths + npaths
+    total_ms = total_ms + ms
+  end
+end
+
+if total_ms > 0 then
+  crawl.stderr(string.format("Total: %.1f paths/s",
+                             total_paths * 1000 / total_ms))
+end
@@ -78,6 +78,8 @@ struct game_state
     bool marked_as_won;
     bool arena_suspended;   // Set if the arena has been temporarily
                             // suspended.
+    bool arena_headless;    // Set while a headless arena is running, so
+                            // turns don't redraw the view.
     bool generating_level;
 
     bool dump_maps;         // Dump map Lua to stderr on fresh parse.
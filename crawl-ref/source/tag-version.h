@@ -277,6 +277,8 @@ enum tag_minor_version
     TAG_MINOR_SPAWN_RATE,          // Remove the env.spawn_random_rate field.
     TAG_MINOR_REMOVE_AK,           // Remove Abyssal Knight.
     TAG_MINOR_BUTTERSUMMONS,       // Alternate ?butt with ?summ, not ?fog.
+    TAG_MINOR_GRID_RUNS,           // Save level grids as run-length planes.
+    TAG_MINOR_TRAVEL_COSTS,        // Save travel costs with the travel cache.
 #endif
     NUM_TAG_MINORS,
     TAG_MINOR_VERSION = NUM_TAG_MINORS - 1
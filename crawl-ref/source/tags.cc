@@ -110,26 +110,31 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 // defined in abyss.cc
 extern abyss_state abyssal_state;
 
+// Size of the staging buffers used for chunk reads and writes.
+static const size_t TAG_STAGE_SIZE = 16384;
+
 reader::reader(const string &_read_filename, int minorVersion)
-    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
-      _minorVersion(minorVersion), _safe_read(false)
+    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _stage(0),
+      _get(0), _get_end(0), _minorVersion(minorVersion), _safe_read(false)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
     opened_file = !!_file;
 }
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
-    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _stage(0), _get(0),
+      _get_end(0), _minorVersion(minorVersion), _safe_read(false)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
+    _stage = new unsigned char[TAG_STAGE_SIZE];
 }
 
 reader::~reader()
 {
     if (_chunk)
         delete _chunk;
+    delete[] _stage;
     close();
 }
 
@@ -142,20 +147,12 @@ void reader::close()
 
 void reader::advance(size_t offset)
 {
-    char junk[128];
-
-    while (offset)
-    {
-        const size_t junklen = min(sizeof(junk), offset);
-        offset -= junklen;
-        read(junk, junklen);
-    }
+    read(nullptr, offset);
 }
 
 bool reader::valid() const
 {
-    return (_file && !feof(_file)) ||
-           (_pbuf && _read_offset < _pbuf->size());
+    return (_file && !feof(_file)) || (!_chunk && _get < _get_end);
 }
 
 static NORETURN void _short_read(bool safe_read)
@@ -167,8 +164,17 @@ static NORETURN void _short_read(bool safe_read)
     die_noline("short read while reading save");
 }
 
+bool reader::refill_stage()
+{
+    if (!_chunk)
+        return false;
+    _get = _stage;
+    _get_end = _stage + _chunk->read(_stage, TAG_STAGE_SIZE);
+    return _get < _get_end;
+}
+
 // Reads input in network byte order, from a file or buffer.
-unsigned char reader::readByte()
+unsigned char reader::read_byte_slow()
 {
     if (_file)
     {
@@ -177,22 +183,13 @@ unsigned char reader::readByte()
             _short_read(_safe_read);
         return b;
     }
-    else if (_chunk)
-    {
-        unsigned char buf;
-        if (_chunk->read(&buf, 1) != 1)
-            _short_read(_safe_read);
-        return buf;
-    }
-    else
-    {
-        if (_read_offset >= _pbuf->size())
-            _short_read(_safe_read);
-        return (*_pbuf)[_read_offset++];
-    }
+
+    if (!refill_stage())
+        _short_read(_safe_read);
+    return *_get++;
 }
 
-void reader::read(void *data, size_t size)
+void reader::read_slow(void *data, size_t size)
 {
     if (_file)
     {
@@ -203,20 +200,50 @@ void reader::read(void *data, size_t size)
         }
         else
             fseek(_file, (long)size, SEEK_CUR);
+        return;
     }
-    else if (_chunk)
+
+    if (!_chunk)
+        _short_read(_safe_read);
+
+    // Use up what is staged, then read large blocks straight from the chunk.
+    const size_t staged = _get_end - _get;
+    if (data && staged)
+        memcpy(data, _get, staged);
+    _get = _get_end;
+    size -= staged;
+    unsigned char *out = data ? static_cast<unsigned char*>(data) + staged
+                              : nullptr;
+
+    if (size >= TAG_STAGE_SIZE)
     {
-        if (_chunk->read(data, size) != size)
-            _short_read(_safe_read);
+        if (out)
+        {
+            if (_chunk->read(out, size) != size)
+                _short_read(_safe_read);
+            return;
+        }
+        while (size >= TAG_STAGE_SIZE)
+        {
+            if (!refill_stage())
+                _short_read(_safe_read);
+            size -= _get_end - _get;
+            _get = _get_end;
+        }
     }
-    else
+
+    while (size)
     {
-        if (_read_offset+size > _pbuf->size())
+        if (!refill_stage())
             _short_read(_safe_read);
-        if (data && size)
-            memcpy(data, &(*_pbuf)[_read_offset], size);
-
-        _read_offset += size;
+        const size_t n = min(size, (size_t) (_get_end - _get));
+        if (out)
+        {
+            memcpy(out, _get, n);
+            out += n;
+        }
+        _get += n;
+        size -= n;
     }
 }
 
@@ -233,15 +260,35 @@ void reader::setMinorVersion(int minorVersion)
 
 void reader::fail_if_not_eof(const string &name)
 {
-    char dummy;
-    if (_chunk ? _chunk->read(&dummy, 1) :
+    if (_chunk ? _get < _get_end || refill_stage() :
         _file ? (fgetc(_file) != EOF) :
-        _read_offset >= _pbuf->size())
+        _get >= _get_end)
     {
         fail("Incomplete read of \"%s\" - aborting.", name.c_str());
     }
 }
 
+writer::writer(package *save, const string &chunkname)
+    : _filename(), _file(0), _chunk(0), _ignore_errors(false), _pbuf(0),
+      failed(false)
+{
+    ASSERT(save);
+    _chunk = save->writer(chunkname);
+    _stage = new unsigned char[TAG_STAGE_SIZE];
+    _put = _stage;
+    _put_end = _stage + TAG_STAGE_SIZE;
+}
+
+writer::~writer()
+{
+    if (_chunk)
+    {
+        flush_stage();
+        delete _chunk;
+    }
+    delete[] _stage;
+}
+
 void writer::check_ok(bool ok)
 {
     if (!ok && !failed)
@@ -252,33 +299,31 @@ void writer::check_ok(bool ok)
     }
 }
 
-void writer::writeByte(unsigned char ch)
+void writer::flush_stage()
 {
-    if (failed)
-        return;
-
-    if (_chunk)
-        _chunk->write(&ch, 1);
-    else if (_file)
-        check_ok(fputc(ch, _file) != EOF);
-    else
-        _pbuf->push_back(ch);
+    if (_put > _stage)
+        _chunk->write(_stage, _put - _stage);
+    _put = _stage;
 }
 
-void writer::write(const void *data, size_t size)
+void writer::write_slow(const void *data, size_t size)
 {
     if (failed)
         return;
 
     if (_chunk)
-        _chunk->write(data, size);
-    else if (_file)
-        check_ok(fwrite(data, 1, size, _file) == size);
-    else
     {
-        const unsigned char* cdata = static_cast<const unsigned char*>(data);
-        _pbuf->insert(_pbuf->end(), cdata, cdata+size);
+        flush_stage();
+        if (size >= TAG_STAGE_SIZE)
+            _chunk->write(data, size);
+        else
+        {
+            memcpy(_put, data, size);
+            _put += size;
+        }
     }
+    else
+        check_ok(fwrite(data, 1, size, _file) == size);
 }
 
 long writer::tell()
@@ -374,62 +419,62 @@ uint8_t unmarshallUByte(reader &th)
 // Marshall 2 byte short in network order.
 void marshallShort(writer &th, short data)
 {
-    // TODO: why does this use `short` and `char` when unmarshall uses int16_t??
     CHECK_INITIALIZED(data);
-    const char b2 = (char)(data & 0x00FF);
-    const char b1 = (char)((data & 0xFF00) >> 8);
-    th.writeByte(b1);
-    th.writeByte(b2);
+    const unsigned char b[2] =
+    {
+        (unsigned char)((data & 0xFF00) >> 8),
+        (unsigned char)(data & 0x00FF),
+    };
+    th.write(b, sizeof(b));
 }
 
 // Unmarshall 2 byte short in network order.
 int16_t unmarshallShort(reader &th)
 {
-    int16_t b1 = th.readByte();
-    int16_t b2 = th.readByte();
-    int16_t data = (b1 << 8) | (b2 & 0x00FF);
-    return data;
+    unsigned char b[2];
+    th.read(b, sizeof(b));
+    return (int16_t)((b[0] << 8) | b[1]);
 }
 
 // Marshall 4 byte int in network order.
 void marshallInt(writer &th, int32_t data)
 {
     CHECK_INITIALIZED(data);
-    char b4 = (char) (data & 0x000000FF);
-    char b3 = (char)((data & 0x0000FF00) >> 8);
-    char b2 = (char)((data & 0x00FF0000) >> 16);
-    char b1 = (char)((data & 0xFF000000) >> 24);
-
-    th.writeByte(b1);
-    th.writeByte(b2);
-    th.writeByte(b3);
-    th.writeByte(b4);
+    const uint32_t u = data;
+    const unsigned char b[4] =
+    {
+        (unsigned char)(u >> 24),
+        (unsigned char)(u >> 16),
+        (unsigned char)(u >> 8),
+        (unsigned char)u,
+    };
+    th.write(b, sizeof(b));
 }
 
 // Unmarshall 4 byte signed int in network order.
 int32_t unmarshallInt(reader &th)
 {
-    int32_t b1 = th.readByte();
-    int32_t b2 = th.readByte();
-    int32_t b3 = th.readByte();
-    int32_t b4 = th.readByte();
-
-    int32_t data = (b1 << 24) | ((b2 & 0x000000FF) << 16);
-    data |= ((b3 & 0x000000FF) << 8) | (b4 & 0x000000FF);
-    return data;
+    unsigned char b[4];
+    th.read(b, sizeof(b));
+    return (int32_t)((uint32_t)b[0] << 24 | (uint32_t)b[1] << 16
+                     | (uint32_t)b[2] << 8 | b[3]);
 }
 
 void marshallUnsigned(writer& th, uint64_t v)
 {
+    // At most ten bytes of seven bits each.
+    unsigned char b[10];
+    size_t n = 0;
     do
     {
-        unsigned char b = (unsigned char)(v & 0x7f);
+        b[n] = (unsigned char)(v & 0x7f);
         v >>= 7;
         if (v)
-            b |= 0x80;
-        th.writeByte(b);
+            b[n] |= 0x80;
+        ++n;
     }
     while (v);
+    th.write(b, n);
 }
 
 uint64_t unmarshallUnsigned(reader& th)
@@ -4791,19 +4836,17 @@ static void _tag_construct_level(writer &th)
 
     CANARY;
 
-    for (int count_x = 0; count_x < GXM; count_x++)
-        for (int count_y = 0; count_y < GYM; count_y++)
-        {
-            marshallByte(th, env.grid[count_x][count_y]);
-            marshallMapCell(th, env.map_knowledge[count_x][count_y]);
-            marshallInt(th, env.pgrid[count_x][count_y].flags);
-        }
+    // Whole planes rather than interleaved cells: most of a level is long
+    // runs of the same feature and the same (usually empty) properties.
+    marshallGridRuns(th, env.grid,
+                     [](dungeon_feature_type feat) { return feat; });
+    marshallGridRuns(th, env.pgrid,
+                     [](terrain_property_t prop) { return prop.flags; });
+    marshallMapKnowledge(th, env.map_knowledge);
 
     marshallBoolean(th, !!env.map_forgotten);
     if (env.map_forgotten)
-        for (int x = 0; x < GXM; x++)
-            for (int y = 0; y < GYM; y++)
-                marshallMapCell(th, (*env.map_forgotten)[x][y]);
+        marshallMapKnowledge(th, *env.map_forgotten);
 
     _run_length_encode(th, marshallByte, env.grid_colours, GXM, GYM);
 
@@ -5716,6 +5759,51 @@ void unmarshallMapCell(reader &th, map_cell& cell)
     cell.flags = cell_flags;
 }
 
+static bool _map_cell_is_blank(const map_cell &cell)
+{
+    return !cell.flags && cell.feat() == DNGN_UNSEEN && !cell.feat_colour()
+           && cell.cloud() == CLOUD_NONE && !cell.item()
+           && cell.monster() == MONS_NO_MONSTER;
+}
+
+// Each stored cell is preceded by the number of blank cells before it; a
+// final count covers any blank cells at the end.
+void marshallMapKnowledge(writer &th, const MapKnowledge &map)
+{
+    unsigned blank = 0;
+    for (int x = 0; x < GXM; ++x)
+        for (int y = 0; y < GYM; ++y)
+        {
+            if (_map_cell_is_blank(map[x][y]))
+            {
+                ++blank;
+                continue;
+            }
+            marshallUnsigned(th, blank);
+            marshallMapCell(th, map[x][y]);
+            blank = 0;
+        }
+    marshallUnsigned(th, blank);
+}
+
+void unmarshallMapKnowledge(reader &th, MapKnowledge &map)
+{
+    const unsigned end = GXM * GYM;
+    unsigned offset = 0;
+    while (true)
+    {
+        const uint64_t blank = unmarshallUnsigned(th);
+        ASSERT(blank <= end - offset);
+        for (const unsigned stop = offset + blank; offset < stop; ++offset)
+            map[offset / GYM][offset % GYM].clear();
+
+        if (offset == end)
+            break;
+        unmarshallMapCell(th, map[offset / GYM][offset % GYM]);
+        ++offset;
+    }
+}
+
 static void _tag_construct_level_items(writer &th)
 {
     // how many traps?
@@ -6318,6 +6406,31 @@ static void _tag_read_level(reader &th)
 
     EAT_CANARY;
 
+#if TAG_MAJOR_VERSION == 34
+    if (th.getMinorVersion() < TAG_MINOR_GRID_RUNS)
+    {
+        for (int i = 0; i < gx; i++)
+            for (int j = 0; j < gy; j++)
+            {
+                env.grid[i][j] = unmarshallFeatureType(th);
+                unmarshallMapCell(th, env.map_knowledge[i][j]);
+                env.pgrid[i][j].flags = unmarshallInt(th);
+            }
+    }
+    else
+    {
+#endif
+    unmarshallGridRuns(th, env.grid,
+                       [](dungeon_feature_type &feat, uint64_t value)
+                       { feat = static_cast<dungeon_feature_type>(value); });
+    unmarshallGridRuns(th, env.pgrid,
+                       [](terrain_property_t &prop, uint64_t value)
+                       { prop.flags = value; });
+    unmarshallMapKnowledge(th, env.map_knowledge);
+#if TAG_MAJOR_VERSION == 34
+    }
+#endif
+
     env.map_seen.reset();
 #if TAG_MAJOR_VERSION == 34
     vector<coord_def> transporters;
@@ -6325,16 +6438,13 @@ static void _tag_read_level(reader &th)
     for (int i = 0; i < gx; i++)
         for (int j = 0; j < gy; j++)
         {
-            dungeon_feature_type feat = unmarshallFeatureType(th);
-            env.grid[i][j] = feat;
-            ASSERT(feat < NUM_FEATURES);
+            ASSERT(env.grid[i][j] < NUM_FEATURES);
 
 #if TAG_MAJOR_VERSION == 34
             // Save these for potential destination clean up.
             if (env.grid[i][j] == DNGN_TRANSPORTER)
                 transporters.push_back(coord_def(i, j));
 #endif
-            unmarshallMapCell(th, env.map_knowledge[i][j]);
             // Fixup positions
             if (env.map_knowledge[i][j].monsterinfo())
                 env.map_knowledge[i][j].monsterinfo()->pos = coord_def(i, j);
@@ -6344,7 +6454,6 @@ static void _tag_read_level(reader &th)
             env.map_knowledge[i][j].flags &= ~MAP_VISIBLE_FLAG;
             if (env.map_knowledge[i][j].seen())
                 env.map_seen.set(i, j);
-            env.pgrid[i][j].flags = unmarshallInt(th);
 
             env.mgrid[i][j] = NON_MONSTER;
         }
@@ -6357,9 +6466,16 @@ static void _tag_read_level(reader &th)
     if (unmarshallBoolean(th))
     {
         MapKnowledge *f = new MapKnowledge();
-        for (int x = 0; x < GXM; x++)
-            for (int y = 0; y < GYM; y++)
-                unmarshallMapCell(th, (*f)[x][y]);
+#if TAG_MAJOR_VERSION == 34
+        if (th.getMinorVersion() < TAG_MINOR_GRID_RUNS)
+        {
+            for (int x = 0; x < GXM; x++)
+                for (int y = 0; y < GYM; y++)
+                    unmarshallMapCell(th, (*f)[x][y]);
+        }
+        else
+#endif
+        unmarshallMapKnowledge(th, *f);
         env.map_forgotten.reset(f);
     }
     else
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include "bitary.h"
@@ -13,6 +14,7 @@
 #include "debug.h"
 #include "defines.h"
 #include "dungeon-feature-type.h"
+#include "fixedarray.h"
 #include "fixedvector.h"
 #include "level-id.h"
 #include "package.h"
@@ -54,31 +56,55 @@ class writer
 public:
     writer(const string &filename, FILE* output, bool ignore_errors = false)
         : _filename(filename), _file(output), _chunk(0),
-          _ignore_errors(ignore_errors), _pbuf(0), failed(false)
+          _ignore_errors(ignore_errors), _pbuf(0), _stage(0), _put(0),
+          _put_end(0), failed(false)
     {
         ASSERT(output);
     }
     writer(vector<unsigned char>* poutput)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          _pbuf(poutput), failed(false) { ASSERT(poutput); }
-    writer(package *save, const string &chunkname)
-        : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          failed(false)
+          _pbuf(poutput), _stage(0), _put(0), _put_end(0), failed(false)
     {
-        ASSERT(save);
-        _chunk = save->writer(chunkname);
+        ASSERT(poutput);
     }
+    writer(package *save, const string &chunkname);
+    ~writer();
 
-    ~writer() { if (_chunk) delete _chunk; }
-
-    void writeByte(unsigned char byte);
-    void write(const void *data, size_t size);
+    // Vectors are appended to directly so that they can be used while the
+    // writer is still around; chunk output is staged and handed over in
+    // large blocks, and files are left to stdio's own buffering.
+    void writeByte(unsigned char byte)
+    {
+        if (_pbuf)
+            _pbuf->push_back(byte);
+        else if (_put < _put_end)
+            *_put++ = byte;
+        else
+            write_slow(&byte, 1);
+    }
+    void write(const void *data, size_t size)
+    {
+        if (_pbuf)
+        {
+            const unsigned char* cdata = static_cast<const unsigned char*>(data);
+            _pbuf->insert(_pbuf->end(), cdata, cdata + size);
+        }
+        else if (size <= (size_t) (_put_end - _put) && _put)
+        {
+            memcpy(_put, data, size);
+            _put += size;
+        }
+        else
+            write_slow(data, size);
+    }
     long tell();
 
     bool succeeded() const { return !failed; }
 
 private:
     void check_ok(bool ok);
+    void write_slow(const void *data, size_t size);
+    void flush_stage();
 
 private:
     string _filename;
@@ -88,6 +114,9 @@ private:
 
     vector<unsigned char>* _pbuf;
 
+    unsigned char *_stage;
+    unsigned char *_put, *_put_end;
+
     bool failed;
 };
 
@@ -115,18 +144,44 @@ class reader
 public:
     reader(const string &filename, int minorVersion = TAG_MINOR_INVALID);
     reader(FILE* input, int minorVersion = TAG_MINOR_INVALID)
-        : _file(input), _chunk(0), opened_file(false), _pbuf(0),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+        : _file(input), _chunk(0), opened_file(false), _pbuf(0), _stage(0),
+          _get(0), _get_end(0), _minorVersion(minorVersion),
+          _safe_read(false) {}
     reader(const vector<unsigned char>& input,
            int minorVersion = TAG_MINOR_INVALID)
-        : _file(0), _chunk(0), opened_file(false), _pbuf(&input),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+        : _file(0), _chunk(0), opened_file(false), _pbuf(&input), _stage(0),
+          _get(input.data()), _get_end(input.data() + input.size()),
+          _minorVersion(minorVersion), _safe_read(false) {}
+    // Reads a range of memory that the caller keeps alive, such as a
+    // mapped file.
+    reader(const unsigned char *input, size_t size,
+           int minorVersion = TAG_MINOR_INVALID)
+        : _file(0), _chunk(0), opened_file(false), _pbuf(0), _stage(0),
+          _get(input), _get_end(input + size), _minorVersion(minorVersion),
+          _safe_read(false) {}
     reader(package *save, const string &chunkname,
            int minorVersion = TAG_MINOR_INVALID);
     ~reader();
 
-    unsigned char readByte();
-    void read(void *data, size_t size);
+    // Buffers are read in place, and chunks through a staging buffer that
+    // is refilled in large blocks; only files go through stdio per byte.
+    unsigned char readByte()
+    {
+        if (_get < _get_end)
+            return *_get++;
+        return read_byte_slow();
+    }
+    void read(void *data, size_t size)
+    {
+        if (size <= (size_t) (_get_end - _get))
+        {
+            if (data && size)
+                memcpy(data, _get, size);
+            _get += size;
+        }
+        else
+            read_slow(data, size);
+    }
     void advance(size_t size);
     int getMinorVersion() const;
     void setMinorVersion(int minorVersion);
@@ -138,13 +193,19 @@ public:
 
     void set_safe_read(bool setting) { _safe_read = setting; }
 
+private:
+    unsigned char read_byte_slow();
+    void read_slow(void *data, size_t size);
+    bool refill_stage();
+
 private:
     string _filename;
     FILE* _file;
     chunk_reader *_chunk;
     bool  opened_file;
     const vector<unsigned char>* _pbuf;
-    unsigned int _read_offset;
+    unsigned char *_stage;
+    const unsigned char *_get, *_get_end;
     int _minorVersion;
     // always throw an exception rather than dying when reading past EOF
     bool _safe_read;
@@ -183,6 +244,71 @@ static inline void unmarshallSigned(reader& th, T& v)
 void marshallMapCell (writer &, const map_cell &);
 void unmarshallMapCell (reader &, map_cell& cell);
 
+/* ***********************************************************************
+ * bulk grid API
+ * *********************************************************************** */
+
+// Write a whole grid plane, column by column, as varint (run, value) pairs.
+// get(cell) gives the unsigned value stored for each cell.
+template<typename T, int WIDTH, int HEIGHT, typename F>
+void marshallGridRuns(writer &th, const FixedArray<T, WIDTH, HEIGHT> &grid,
+                      F get)
+{
+    uint64_t last = 0, run = 0;
+    for (int x = 0; x < WIDTH; ++x)
+        for (int y = 0; y < HEIGHT; ++y)
+        {
+            const uint64_t value = get(grid[x][y]);
+            if (run && value == last)
+            {
+                ++run;
+                continue;
+            }
+            if (run)
+            {
+                marshallUnsigned(th, run);
+                marshallUnsigned(th, last);
+            }
+            last = value;
+            run = 1;
+        }
+
+    marshallUnsigned(th, run);
+    marshallUnsigned(th, last);
+}
+
+// Read a plane written by marshallGridRuns(); set(cell, value) stores each
+// value.
+template<typename T, int WIDTH, int HEIGHT, typename F>
+void unmarshallGridRuns(reader &th, FixedArray<T, WIDTH, HEIGHT> &grid, F set)
+{
+    const uint64_t end = (uint64_t) WIDTH * HEIGHT;
+    uint64_t offset = 0;
+    int x = 0, y = 0;
+    while (offset < end)
+    {
+        const uint64_t run = unmarshallUnsigned(th);
+        const uint64_t value = unmarshallUnsigned(th);
+        ASSERT(run && run <= end - offset);
+
+        offset += run;
+        for (uint64_t i = 0; i < run; ++i)
+        {
+            set(grid[x][y], value);
+            if (++y == HEIGHT)
+            {
+                y = 0;
+                ++x;
+            }
+        }
+    }
+}
+
+// Map knowledge, with runs of never-seen cells stored as a count.
+void marshallMapKnowledge(writer &th,
+                          const FixedArray<map_cell, GXM, GYM> &map);
+void unmarshallMapKnowledge(reader &th, FixedArray<map_cell, GXM, GYM> &map);
+
 FixedVector<spell_type, MAX_KNOWN_SPELLS> unmarshall_player_spells(reader &th);
 
 void unmarshallSpells(reader &, monster_spells &
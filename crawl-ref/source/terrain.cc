@@ -34,6 +34,7 @@
 #include "mapmark.h"
 #include "message.h"
 #include "mon-behv.h"
+#include "mon-pathfind.h"
 #include "mon-place.h"
 #include "mon-poly.h"
 #include "mon-util.h"
@@ -1963,6 +1964,7 @@ void set_terrain_changed(const coord_def p)
     dungeon_events.fire_position_event(DET_FEAT_CHANGE, p);
 
     los_terrain_changed(p);
+    invalidate_shared_pathfinding();
 }
 
 /**
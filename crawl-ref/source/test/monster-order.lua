@@ -0,0 +1,37 @@
+-- Check that monster turns replay identically from the same seed, so that
+-- seeded games stay reproducible.
+
+local seed = 20210608
+local rounds = 50
+
+local function run_fight()
+  debug.reset_rng(seed)
+  dgn.reset_level()
+  dgn.fill_grd_area(20, 20, 40, 32, 'floor')
+  you.moveto(2, 2)
+
+  -- Two lines of evenly matched, awake monsters, so that many of them have
+  -- the same energy and their order depends only on the action queue.
+  for i = 0, 9 do
+    dgn.create_monster(21 + 2 * i, 24, "generate_awake orc att:friendly")
+    dgn.create_monster(21 + 2 * i, 28, "generate_awake goblin")
+    dgn.create_monster(22 + 2 * i, 28, "generate_awake hobgoblin")
+  end
+
+  local trace = { }
+  for round = 1, rounds do
+    debug.handle_monsters()
+    for mons in test.level_monster_iterator() do
+      table.insert(trace, string.format("%d:%s@%d,%d:%d:%d", round,
+                                        mons.name, mons.x, mons.y, mons.hp,
+                                        mons.energy))
+    end
+  end
+
+  dgn.dismiss_monsters()
+  return table.concat(trace, " ")
+end
+
+local first = run_fight()
+local second = run_fight()
+assert(first == second, "Monster actions differ between seeded replays")
@@ -255,6 +255,7 @@ void TilesFramework::finish_message()
                             "failed (%s), breaking.\n", errmsg);
 #endif
                         m_dest_addrs.erase(m_dest_addrs.begin() + i);
+                        m_dest_packed_map.erase(m_dest_packed_map.begin() + i);
                         i--;
                         break;
                     }
@@ -436,7 +437,12 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         JsonWrapper primary = json_find_member(obj.node, "primary");
         primary.check(JSON_BOOL);
 
+        JsonWrapper packed_map = json_find_member(obj.node, "packed_map");
+
         m_dest_addrs.push_back(addr);
+        m_dest_packed_map.push_back(packed_map.node
+                                    && packed_map->tag == JSON_BOOL
+                                    && packed_map->bool_);
         m_controlled_from_web = primary->bool_;
     }
     else if (msgtype == "key")
@@ -1623,8 +1629,6 @@ void TilesFramework::_send_cell(const coord_def &gc,
         const packed_cell &current_pc = current_sc.tile;
 
         const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
-
-        const bool in_water = _in_water(next_pc);
         bool fg_changed = false;
 
         if (next_pc.fg != current_pc.fg)
@@ -1713,81 +1717,7 @@ void TilesFramework::_send_cell(const coord_def &gc,
             json_close_object();
         }
 
-        if (fg_idx >= TILEP_MCACHE_START)
-        {
-            if (fg_changed)
-            {
-                mcache_entry *entry = mcache.get(fg_idx);
-                if (entry)
-                    send_mcache(entry, in_water);
-                else
-                {
-                    json_write_comma();
-                    write_message("\"doll\":[[%d,%d]]", TILEP_MONS_UNKNOWN, TILE_Y);
-                    json_write_null("mcache");
-                }
-            }
-        }
-        else if (fg_idx == TILEP_PLAYER)
-        {
-            bool player_doll_changed = false;
-            dolls_data result = player_doll;
-            fill_doll_equipment(result);
-            if (result != last_player_doll)
-            {
-                player_doll_changed = true;
-                last_player_doll = result;
-            }
-            if (fg_changed || player_doll_changed)
-            {
-                send_doll(last_player_doll, in_water, false);
-                if (Options.tile_use_monster != MONS_0)
-                {
-                    monster_info minfo(MONS_PLAYER, MONS_PLAYER);
-                    minfo.props[MONSTER_TILE_KEY] =
-                        short(last_player_doll.parts[TILEP_PART_BASE]);
-                    item_def *item;
-                    if (you.slot_item(EQ_WEAPON))
-                    {
-                        item = new item_def(
-                            get_item_known_info(*you.slot_item(EQ_WEAPON)));
-                        minfo.inv[MSLOT_WEAPON].reset(item);
-                    }
-                    if (you.slot_item(EQ_SHIELD))
-                    {
-                        item = new item_def(
-                            get_item_known_info(*you.slot_item(EQ_SHIELD)));
-                        minfo.inv[MSLOT_SHIELD].reset(item);
-                    }
-                    tileidx_t mcache_idx = mcache.register_monster(minfo);
-                    mcache_entry *entry = mcache.get(mcache_idx);
-                    if (entry)
-                        send_mcache(entry, in_water, false);
-                    else
-                        json_write_null("mcache");
-                }
-                else
-                    json_write_null("mcache");
-            }
-        }
-        else if (get_tile_texture(fg_idx) == TEX_PLAYER)
-        {
-            if (fg_changed)
-            {
-                json_write_comma();
-                write_message("\"doll\":[[%u,%d]]", (unsigned int) fg_idx, TILE_Y);
-                json_write_null("mcache");
-            }
-        }
-        else
-        {
-            if (fg_changed)
-            {
-                json_write_comma();
-                json_write_null("doll");
-                json_write_null("mcache");
-            }
-        }
+        _send_cell_doll(next_pc, fg_changed);
 
         bool overlays_changed = false;
 
@@ -1816,6 +1746,381 @@ void TilesFramework::_send_cell(const coord_def &gc,
     json_close_object(true);
 }
 
+// Servers can ask for packed map cells when they attach. A packed map
+// message still has "cells", but only for monsters and dolls, which are
+// always JSON; everything else about a cell goes into "packed", the base64
+// of
+//
+//   uint version (1), uint GXM, uint origin x, uint origin y
+//
+// followed by each cell that changed, in grid order, as
+//
+//   uint cells skipped since the last one, uint mask of PC_* fields
+//
+// and then each field in the mask, in bit order. As with the JSON, fields
+// are only sent if they differ from the last frame. uints are LEB128, ints
+// are zigzag coded uints, and tile indices are their low and high 32 bits
+// as uints. See unpack_cells() in map_knowledge.js.
+enum packed_cell_field
+{
+    PC_FEAT            = 1 << 0,
+    PC_MAP_FEATURE     = 1 << 1,
+    PC_GLYPH           = 1 << 2,
+    PC_COLOUR          = 1 << 3,
+    PC_FG              = 1 << 4,
+    PC_BASE            = 1 << 5,
+    PC_BG              = 1 << 6,
+    PC_CLOUD           = 1 << 7,
+    PC_ICONS           = 1 << 8,  // count, then tile indices
+    PC_FLAGS           = 1 << 9,  // mask of changed PCF_*, then their values
+    PC_HALO            = 1 << 10, // int
+    PC_ORB_GLOW        = 1 << 11,
+    PC_BLOOD_ROTATION  = 1 << 12, // int
+    PC_TRAVEL_TRAIL    = 1 << 13,
+    PC_FLAVOUR         = 1 << 14, // floor, then special
+    PC_OVERLAYS        = 1 << 15, // count, then ints
+};
+
+enum packed_cell_flag
+{
+    PCF_BLOODY,
+    PCF_OLD_BLOOD,
+    PCF_SILENCED,
+    PCF_HIGHLIGHTED_SUMMONER,
+    PCF_SANCTUARY,
+    PCF_LIQUEFIED,
+    PCF_QUAD_GLOW,
+    PCF_DISJUNCT,
+    PCF_MANGROVE_WATER,
+    PCF_AWAKENED_FOREST,
+};
+
+#define PACKED_MAP_VERSION 1
+
+static void _pack_uint(string &buf, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back((char) ((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((char) v);
+}
+
+static void _pack_int(string &buf, int v)
+{
+    _pack_uint(buf, ((uint32_t) v << 1) ^ (uint32_t) (v >> 31));
+}
+
+static void _pack_tileidx(string &buf, tileidx_t t)
+{
+    _pack_uint(buf, t & 0xFFFFFFFF);
+    _pack_uint(buf, t >> 32);
+}
+
+static void _append_base64(string &out, const string &in)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    out.reserve(out.size() + (in.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3)
+    {
+        const uint32_t n = (uint8_t) in[i] << 16 | (uint8_t) in[i + 1] << 8
+                           | (uint8_t) in[i + 2];
+        out.push_back(digits[n >> 18]);
+        out.push_back(digits[n >> 12 & 0x3f]);
+        out.push_back(digits[n >> 6 & 0x3f]);
+        out.push_back(digits[n & 0x3f]);
+    }
+    if (i < in.size())
+    {
+        const bool two = i + 1 < in.size();
+        const uint32_t n = (uint8_t) in[i] << 16
+                           | (two ? (uint8_t) in[i + 1] << 8 : 0);
+        out.push_back(digits[n >> 18]);
+        out.push_back(digits[n >> 12 & 0x3f]);
+        out.push_back(two ? digits[n >> 6 & 0x3f] : '=');
+        out.push_back('=');
+    }
+}
+
+// Only pack cells if everyone listening can unpack them.
+bool TilesFramework::_packed_map_wanted() const
+{
+    return !m_dest_addrs.empty()
+           && all_of(m_dest_packed_map.begin(), m_dest_packed_map.end(),
+                     [](bool packed) { return packed; });
+}
+
+// The packed counterpart of _send_cell(): appends the cell to m_packed_cells
+// if anything but its monster or doll changed, and writes those into the
+// open "cells" array.
+void TilesFramework::_pack_cell(const coord_def &gc,
+                                const screen_cell_t &current_sc, const screen_cell_t &next_sc,
+                                const map_cell &current_mc, const map_cell &next_mc,
+                                map<uint32_t, coord_def>& new_monster_locs,
+                                bool force_full, int &last_index)
+{
+    static string fields;
+    fields.clear();
+    uint32_t mask = 0;
+
+    if (current_mc.feat() != next_mc.feat())
+    {
+        mask |= PC_FEAT;
+        _pack_uint(fields, next_mc.feat());
+    }
+
+    map_feature mf = get_cell_map_feature(gc);
+    if (get_cell_map_feature(current_mc) != mf)
+    {
+        mask |= PC_MAP_FEATURE;
+        _pack_uint(fields, mf);
+    }
+
+    char32_t glyph = next_sc.glyph;
+    if (current_sc.glyph != glyph)
+    {
+        mask |= PC_GLYPH;
+        _pack_uint(fields, glyph);
+    }
+    if ((current_sc.colour != next_sc.colour
+         || current_sc.glyph == ' ') && glyph != ' ')
+    {
+        int col = next_sc.colour;
+        col = (_get_highlight(col) << 4) | macro_colour(col & 0xF);
+        mask |= PC_COLOUR;
+        _pack_uint(fields, col);
+    }
+
+    const packed_cell &next_pc = next_sc.tile;
+    const packed_cell &current_pc = current_sc.tile;
+    const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
+    const bool fg_changed = next_pc.fg != current_pc.fg;
+
+    if (fg_changed)
+    {
+        mask |= PC_FG;
+        _pack_tileidx(fields, next_pc.fg);
+        if (get_tile_texture(fg_idx) == TEX_DEFAULT)
+        {
+            mask |= PC_BASE;
+            _pack_uint(fields, tileidx_known_base_item(fg_idx));
+        }
+    }
+
+    if (next_pc.bg != current_pc.bg)
+    {
+        mask |= PC_BG;
+        _pack_tileidx(fields, next_pc.bg);
+    }
+
+    if (next_pc.cloud != current_pc.cloud)
+    {
+        mask |= PC_CLOUD;
+        _pack_tileidx(fields, next_pc.cloud);
+    }
+
+    if (next_pc.icons != current_pc.icons)
+    {
+        mask |= PC_ICONS;
+        _pack_uint(fields, next_pc.icons.size());
+        for (const tileidx_t icon : next_pc.icons)
+            _pack_tileidx(fields, icon);
+    }
+
+    uint32_t changed = 0, values = 0;
+    auto flag = [&changed, &values](packed_cell_flag f, bool next, bool cur)
+    {
+        if (next != cur)
+        {
+            changed |= 1 << f;
+            values |= (uint32_t) next << f;
+        }
+    };
+    if (Options.show_blood)
+    {
+        flag(PCF_BLOODY, next_pc.is_bloody, current_pc.is_bloody);
+        flag(PCF_OLD_BLOOD, next_pc.old_blood, current_pc.old_blood);
+    }
+    flag(PCF_SILENCED, next_pc.is_silenced, current_pc.is_silenced);
+    flag(PCF_HIGHLIGHTED_SUMMONER, next_pc.is_highlighted_summoner,
+         current_pc.is_highlighted_summoner);
+    flag(PCF_SANCTUARY, next_pc.is_sanctuary, current_pc.is_sanctuary);
+    flag(PCF_LIQUEFIED, next_pc.is_liquefied, current_pc.is_liquefied);
+    flag(PCF_QUAD_GLOW, next_pc.quad_glow, current_pc.quad_glow);
+    flag(PCF_DISJUNCT, next_pc.disjunct, current_pc.disjunct);
+    flag(PCF_MANGROVE_WATER, next_pc.mangrove_water,
+         current_pc.mangrove_water);
+    flag(PCF_AWAKENED_FOREST, next_pc.awakened_forest,
+         current_pc.awakened_forest);
+    if (changed)
+    {
+        mask |= PC_FLAGS;
+        _pack_uint(fields, changed);
+        _pack_uint(fields, values);
+    }
+
+    if (next_pc.halo != current_pc.halo)
+    {
+        mask |= PC_HALO;
+        _pack_int(fields, next_pc.halo);
+    }
+
+    if (next_pc.orb_glow != current_pc.orb_glow)
+    {
+        mask |= PC_ORB_GLOW;
+        _pack_uint(fields, next_pc.orb_glow);
+    }
+
+    if (next_pc.blood_rotation != current_pc.blood_rotation)
+    {
+        mask |= PC_BLOOD_ROTATION;
+        _pack_int(fields, next_pc.blood_rotation);
+    }
+
+    if (next_pc.travel_trail != current_pc.travel_trail)
+    {
+        mask |= PC_TRAVEL_TRAIL;
+        _pack_uint(fields, next_pc.travel_trail);
+    }
+
+    if (_needs_flavour(next_pc) &&
+        (next_pc.flv.floor != current_pc.flv.floor
+         || next_pc.flv.special != current_pc.flv.special
+         || !_needs_flavour(current_pc)
+         || force_full))
+    {
+        mask |= PC_FLAVOUR;
+        _pack_uint(fields, next_pc.flv.floor);
+        _pack_uint(fields, next_pc.flv.special);
+    }
+
+    bool overlays_changed =
+        next_pc.num_dngn_overlay != current_pc.num_dngn_overlay;
+    for (int i = 0; !overlays_changed && i < next_pc.num_dngn_overlay; i++)
+        overlays_changed = next_pc.dngn_overlay[i] != current_pc.dngn_overlay[i];
+    if (overlays_changed)
+    {
+        mask |= PC_OVERLAYS;
+        _pack_uint(fields, next_pc.num_dngn_overlay);
+        for (int i = 0; i < next_pc.num_dngn_overlay; ++i)
+            _pack_int(fields, next_pc.dngn_overlay[i]);
+    }
+
+    if (mask)
+    {
+        const int index = gc.y * GXM + gc.x;
+        _pack_uint(m_packed_cells, index - last_index - 1);
+        _pack_uint(m_packed_cells, mask);
+        m_packed_cells += fields;
+        last_index = index;
+    }
+
+    json_open_object();
+    json_write_int("x", gc.x - m_origin.x);
+    json_write_int("y", gc.y - m_origin.y);
+    json_treat_as_empty();
+
+    if (next_mc.monsterinfo())
+        _send_monster(gc, next_mc.monsterinfo(), new_monster_locs, force_full);
+    else if (current_mc.monsterinfo())
+        json_write_null("mon");
+
+    json_open_object("t");
+    _send_cell_doll(next_pc, fg_changed);
+    json_close_object(true);
+
+    json_close_object(true);
+}
+
+// The doll or mcache entry drawn for a cell's foreground, if it has
+// changed. Written into the cell's "t" object.
+void TilesFramework::_send_cell_doll(const packed_cell &next_pc,
+                                     bool fg_changed)
+{
+    const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
+    const bool in_water = _in_water(next_pc);
+
+    if (fg_idx >= TILEP_MCACHE_START)
+    {
+        if (fg_changed)
+        {
+            mcache_entry *entry = mcache.get(fg_idx);
+            if (entry)
+                send_mcache(entry, in_water);
+            else
+            {
+                json_write_comma();
+                write_message("\"doll\":[[%d,%d]]", TILEP_MONS_UNKNOWN, TILE_Y);
+                json_write_null("mcache");
+            }
+        }
+    }
+    else if (fg_idx == TILEP_PLAYER)
+    {
+        bool player_doll_changed = false;
+        dolls_data result = player_doll;
+        fill_doll_equipment(result);
+        if (result != last_player_doll)
+        {
+            player_doll_changed = true;
+            last_player_doll = result;
+        }
+        if (fg_changed || player_doll_changed)
+        {
+            send_doll(last_player_doll, in_water, false);
+            if (Options.tile_use_monster != MONS_0)
+            {
+                monster_info minfo(MONS_PLAYER, MONS_PLAYER);
+                minfo.props[MONSTER_TILE_KEY] =
+                    short(last_player_doll.parts[TILEP_PART_BASE]);
+                item_def *item;
+                if (you.slot_item(EQ_WEAPON))
+                {
+                    item = new item_def(
+                        get_item_known_info(*you.slot_item(EQ_WEAPON)));
+                    minfo.inv[MSLOT_WEAPON].reset(item);
+                }
+                if (you.slot_item(EQ_SHIELD))
+                {
+                    item = new item_def(
+                        get_item_known_info(*you.slot_item(EQ_SHIELD)));
+                    minfo.inv[MSLOT_SHIELD].reset(item);
+                }
+                tileidx_t mcache_idx = mcache.register_monster(minfo);
+                mcache_entry *entry = mcache.get(mcache_idx);
+                if (entry)
+                    send_mcache(entry, in_water, false);
+                else
+                    json_write_null("mcache");
+            }
+            else
+                json_write_null("mcache");
+        }
+    }
+    else if (get_tile_texture(fg_idx) == TEX_PLAYER)
+    {
+        if (fg_changed)
+        {
+            json_write_comma();
+            write_message("\"doll\":[[%u,%d]]", (unsigned int) fg_idx, TILE_Y);
+            json_write_null("mcache");
+        }
+    }
+    else
+    {
+        if (fg_changed)
+        {
+            json_write_comma();
+            json_write_null("doll");
+            json_write_null("mcache");
+        }
+    }
+}
+
 void TilesFramework::_send_cursor(cursor_type type)
 {
     if (m_cursor[type] == NO_CURSOR)
@@ -1900,6 +2205,10 @@ void TilesFramework::_send_map(bool force_full)
     coord_def last_gc(0, 0);
     bool send_gc = true;
 
+    const bool packed = _packed_map_wanted();
+    int last_index = -1;
+    m_packed_cells.clear();
+
     json_open_array("cells");
     for (int y = 0; y < GYM; y++)
         for (int x = 0; x < GXM; x++)
@@ -1922,6 +2231,18 @@ void TilesFramework::_send_map(bool force_full)
             if (m_origin.equals(-1, -1))
                 m_origin = gc;
 
+            const screen_cell_t& sc = force_full ? default_cell
+                : m_current_view(gc);
+            const map_cell& mc = force_full ? default_map_cell
+                : m_current_map_knowledge(gc);
+
+            if (packed)
+            {
+                _pack_cell(gc, sc, m_next_view(gc), mc, env.map_knowledge(gc),
+                           new_monster_locs, force_full, last_index);
+                continue;
+            }
+
             json_open_object();
             if (send_gc
                 || last_gc.x + 1 != gc.x
@@ -1932,10 +2253,6 @@ void TilesFramework::_send_map(bool force_full)
                 json_treat_as_empty();
             }
 
-            const screen_cell_t& sc = force_full ? default_cell
-                : m_current_view(gc);
-            const map_cell& mc = force_full ? default_map_cell
-                : m_current_map_knowledge(gc);
             _send_cell(gc,
                        sc,
                        m_next_view(gc),
@@ -1951,6 +2268,20 @@ void TilesFramework::_send_map(bool force_full)
         }
     json_close_array(true);
 
+    if (!m_packed_cells.empty())
+    {
+        string header;
+        _pack_uint(header, PACKED_MAP_VERSION);
+        _pack_uint(header, GXM);
+        _pack_uint(header, m_origin.x);
+        _pack_uint(header, m_origin.y);
+
+        json_write_name("packed");
+        m_msg_buf.push_back('"');
+        _append_base64(m_msg_buf, header + m_packed_cells);
+        m_msg_buf.push_back('"');
+    }
+
     json_close_object(true);
 
     finish_message();
@@ -225,6 +225,8 @@ protected:
     int m_max_msg_size;
     string m_msg_buf;
     vector<sockaddr_un> m_dest_addrs;
+    // Whether each of m_dest_addrs asked for packed map cells.
+    vector<bool> m_dest_packed_map;
 
     bool m_controlled_from_web;
     bool m_need_flush;
@@ -290,6 +292,7 @@ protected:
     FixedArray<map_cell, GXM, GYM> m_current_map_knowledge;
     map<uint32_t, coord_def> m_monster_locs;
     bool m_need_full_map;
+    string m_packed_cells;
 
     coord_def m_cursor[CURSOR_MAX];
     coord_def m_last_clicked_grid;
@@ -325,6 +328,13 @@ protected:
                     const map_cell &current_mc, const map_cell &next_mc,
                     map<uint32_t, coord_def>& new_monster_locs,
                     bool force_full);
+    void _send_cell_doll(const packed_cell &next_pc, bool fg_changed);
+    bool _packed_map_wanted() const;
+    void _pack_cell(const coord_def &gc,
+                    const screen_cell_t &current_sc, const screen_cell_t &next_sc,
+                    const map_cell &current_mc, const map_cell &next_mc,
+                    map<uint32_t, coord_def>& new_monster_locs,
+                    bool force_full, int &last_index);
     void _send_monster(const coord_def &gc, const monster_info* m,
                        map<uint32_t, coord_def>& new_monster_locs,
                        bool force_full);
@@ -18,6 +18,7 @@
 #include <set>
 #include <sstream>
 
+#include "bitary.h"
 #include "branch.h"
 #include "cloud.h"
 #include "clua.h"
@@ -53,6 +54,7 @@
 #include "state.h"
 #include "stringutil.h"
 #include "tag-version.h"
+#include "tags.h"
 #include "terrain.h"
 #include "tiles-build-specific.h"
 #include "traps.h"
@@ -922,6 +924,224 @@ void explore_pickup_event(int did_pickup, int tried_pickup)
     }
 }
 
+// What a travel flood saw: the order squares were expanded in, and for each
+// square the flood looked at, whether it was safe and what it cost to enter.
+struct travel_flood_record
+{
+    // Otherwise the state is 1 + the traverse cost of a safe square.
+    static const uint8_t UNSEEN = 0;
+    static const uint8_t UNSAFE = 1;
+
+    FixedArray<int, GXM, GYM> expanded;     // -1 if never expanded
+    FixedArray<uint8_t, GXM, GYM> state;
+    int count;
+
+    void clear()
+    {
+        expanded.init(-1);
+        state.init(UNSEEN);
+        count = 0;
+    }
+
+    static uint8_t safe_state(const coord_def &c)
+    {
+        return 1 + _feature_traverse_cost(env.map_knowledge(c).feat());
+    }
+
+    static uint8_t current_state(const coord_def &c)
+    {
+        return is_travelsafe_square(c) ? safe_state(c) : UNSAFE;
+    }
+};
+
+// A travel flood towards the current travel destination, kept from one
+// travel step to the next. Stepping closer to the destination doesn't change
+// the flood, so while nothing it depends on has changed, the next move can
+// be read off the squares it already expanded rather than flooding back from
+// the destination again. Map knowledge only changes in view during travel,
+// so only the squares in view and the ones whose safety depends on the
+// player (clouds, traps and monsters) need checking each step.
+class travel_step_cache
+{
+public:
+    travel_step_cache() : valid(false), turn(0), exclusions(0),
+                          slime_immune(false)
+    {
+    }
+
+    void clear()
+    {
+        valid = false;
+    }
+
+    coord_def next_move(const coord_def &youpos, const coord_def &dest);
+
+private:
+    coord_def rebuild(const coord_def &youpos, const coord_def &dest);
+    bool still_valid(const coord_def &youpos, const coord_def &dest) const;
+
+    static void get_traversable(FixedBitVector<NUM_FEATURES> &feats);
+    static void get_transporters(vector<pair<coord_def, coord_def>> &trans);
+
+private:
+    bool valid;
+    level_id level;
+    coord_def target;
+    int turn;
+    unsigned int exclusions;
+    bool slime_immune;
+    FixedBitVector<NUM_FEATURES> traversable;
+    vector<pair<coord_def, coord_def>> transporters;
+    vector<coord_def> volatile_squares;
+    travel_flood_record record;
+};
+
+static travel_step_cache _travel_steps;
+
+void travel_step_cache::get_traversable(FixedBitVector<NUM_FEATURES> &feats)
+{
+    for (int i = 0; i < NUM_FEATURES; ++i)
+    {
+        const dungeon_feature_type feat = static_cast<dungeon_feature_type>(i);
+        feats.set(i, feat_is_traversable_now(feat)
+                     && !_feat_is_blocking_door(feat)
+                     && _feature_traverse_cost(feat) == 1);
+    }
+}
+
+void travel_step_cache::get_transporters(
+    vector<pair<coord_def, coord_def>> &trans)
+{
+    trans.clear();
+    LevelInfo &li = travel_cache.get_level_info(level_id::current());
+    for (const transporter_info &ti : li.get_transporters())
+        trans.emplace_back(ti.position, ti.destination);
+}
+
+coord_def travel_step_cache::rebuild(const coord_def &youpos,
+                                     const coord_def &dest)
+{
+    travel_pathfind tp;
+    tp.set_src_dst(youpos, dest);
+    tp.set_flood_record(&record);
+    const coord_def move = tp.pathfind(RMODE_TRAVEL, false);
+
+    valid = true;
+    level = level_id::current();
+    target = dest;
+    turn = you.num_turns;
+    exclusions = exclude_set::generation();
+    slime_immune = actor_slime_wall_immune(&you);
+    get_traversable(traversable);
+    get_transporters(transporters);
+
+    volatile_squares.clear();
+    for (rectangle_iterator ri(0); ri; ++ri)
+    {
+        if (record.state(*ri) == travel_flood_record::UNSEEN)
+            continue;
+
+        const map_cell &cell = env.map_knowledge(*ri);
+        if (cell.cloud() != CLOUD_NONE || cell.monsterinfo()
+            || feat_is_trap(cell.feat()))
+        {
+            volatile_squares.push_back(*ri);
+        }
+    }
+
+    return move;
+}
+
+bool travel_step_cache::still_valid(const coord_def &youpos,
+                                    const coord_def &dest) const
+{
+    if (!valid || dest != target || level != level_id::current()
+        || you.num_turns - turn > 1
+        || exclusions != exclude_set::generation()
+        || slime_immune != actor_slime_wall_immune(&you))
+    {
+        return false;
+    }
+
+    // pathfind() gives up straight away if the destination isn't safe.
+    if (!is_travelsafe_square(dest, false, false, true) && !is_trap(dest))
+        return false;
+
+    FixedBitVector<NUM_FEATURES> feats;
+    get_traversable(feats);
+    if (feats != traversable)
+        return false;
+
+    vector<pair<coord_def, coord_def>> trans;
+    get_transporters(trans);
+    if (trans != transporters)
+        return false;
+
+    for (const coord_def &c : volatile_squares)
+        if (travel_flood_record::current_state(c) != record.state(c))
+            return false;
+
+    for (radius_iterator ri(youpos, LOS_DEFAULT); ri; ++ri)
+    {
+        const uint8_t state = record.state(*ri);
+        if (state != travel_flood_record::UNSEEN
+            && travel_flood_record::current_state(*ri) != state)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The first move of the travel_pathfind flood from dest back to youpos, as
+ * pathfind(RMODE_TRAVEL, false) would find it, reusing the flood from earlier
+ * steps towards the same destination where possible.
+ *
+ * The flood expands squares in the same order whatever its destination, and
+ * stops at the first expanded square next to it, so for any youpos next to
+ * an already expanded square the answer is the earliest such square.
+ */
+coord_def travel_step_cache::next_move(const coord_def &youpos,
+                                       const coord_def &dest)
+{
+    if (youpos == dest || !still_valid(youpos, dest))
+        return rebuild(youpos, dest);
+
+    coord_def best;
+    int best_order = INT_MAX;
+    auto consider = [&](const coord_def &c)
+    {
+        const int order = record.expanded(c);
+        if (order >= 0 && order < best_order)
+        {
+            best = c;
+            best_order = order;
+        }
+    };
+
+    for (adjacent_iterator ai(youpos); ai; ++ai)
+        if (in_bounds(*ai))
+            consider(*ai);
+
+    // Travel floods back through transporter landings to the transporter.
+    for (const auto &trans : transporters)
+    {
+        if (trans.first == youpos && in_bounds(trans.second)
+            && env.grid(trans.second) == DNGN_TRANSPORTER_LANDING)
+        {
+            consider(trans.second);
+        }
+    }
+
+    if (best_order == INT_MAX)
+        return rebuild(youpos, dest);
+
+    turn = you.num_turns;
+    return _is_safe_move(best) ? best : coord_def();
+}
+
 /**
  * Run the travel_pathfind algorithm with a destination with the aim of
  * determining the next travel move. Try to avoid to let travel (including
@@ -940,13 +1160,13 @@ void explore_pickup_event(int did_pickup, int tried_pickup)
  */
 static void _find_travel_pos(const coord_def& youpos, int *move_x, int *move_y)
 {
-    travel_pathfind tp;
-
-    tp.set_src_dst(youpos, you.running.pos);
-
-    coord_def dest = tp.pathfind(RMODE_TRAVEL, false);
+    coord_def dest = _travel_steps.next_move(youpos, you.running.pos);
     if (dest.origin())
+    {
+        travel_pathfind tp;
+        tp.set_src_dst(youpos, you.running.pos);
         dest = tp.pathfind(RMODE_TRAVEL, true);
+    }
     coord_def new_dest = dest;
 
     // We'd either have to travel through a runed door, in which case we'll be
@@ -1272,7 +1492,7 @@ travel_pathfind::travel_pathfind()
       unexplored_place(), greedy_place(), unexplored_dist(0), greedy_dist(0),
       refdist(nullptr), reseed_points(), features(nullptr), unreachables(),
       point_distance(travel_point_distance), next_iter_points(0),
-      traveled_distance(0), circ_index(0)
+      traveled_distance(0), circ_index(0), record(nullptr)
 {
 }
 
@@ -1310,6 +1530,11 @@ void travel_pathfind::set_floodseed(const coord_def &seed, bool dblflood)
     double_flood = dblflood;
 }
 
+void travel_pathfind::set_flood_record(travel_flood_record *rec)
+{
+    record = rec;
+}
+
 void travel_pathfind::set_feature_vector(vector<coord_def> *feats)
 {
     features = feats;
@@ -1395,6 +1620,8 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
     // point_distance will hold the distance of all points from the starting
     // point, i.e. the distance travelled to get there.
     memset(point_distance, 0, sizeof(travel_distance_grid_t));
+    if (record)
+        record->clear();
 
     if (!in_bounds(start))
         return coord_def();
@@ -1441,6 +1668,8 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
     // overwritten with newer ones. Since we count the number of points for
     // next round in next_iter_points, we don't even need to reset the array.
     circumference[circ_index][0] = start;
+    if (record)
+        record->state(start) = travel_flood_record::safe_state(start);
 
     bool found_target = false;
 
@@ -1748,6 +1977,9 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
     }
     else if (!is_travelsafe_square(dc, ignore_hostile, ignore_danger, try_fallback))
     {
+        if (record)
+            record->state(dc) = travel_flood_record::UNSAFE;
+
         // This point is not okay to travel on, but if this is a
         // trap, we'll want to put it on the feature vector anyway.
         if (_is_reseedable(dc, ignore_danger)
@@ -1781,6 +2013,8 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
         // iteration
         circumference[!circ_index][next_iter_points++] = dc;
         point_distance[dc.x][dc.y] = traveled_distance;
+        if (record)
+            record->state(dc) = travel_flood_record::safe_state(dc);
 
         // Negative distances here so that show_map can colour
         // the map differently for these squares.
@@ -1856,6 +2090,9 @@ bool travel_pathfind::path_examine_point(const coord_def &c)
     if (point_traverse_delay(c))
         return false;
 
+    if (record)
+        record->expanded(c) = record->count++;
+
     bool found_target = false;
 
     // For each point, we look at all surrounding points. Take them orthogonals
@@ -3105,19 +3342,8 @@ static int _find_transtravel_stair(const level_id &cur,
     return local_distance;
 }
 
-static bool _loadlev_populate_stair_distances(const level_pos &target)
+static void _record_stair_distances(const level_pos &target)
 {
-    level_excursion excursion;
-    excursion.go_to(target.id);
-    _populate_stair_distances(target);
-    return true;
-}
-
-static void _populate_stair_distances(const level_pos &target)
-{
-    // Populate travel_point_distance.
-    fill_travel_point_distance(target.pos);
-
     curr_stairs.clear();
     for (stair_info si : travel_cache.get_level_info(target.id).get_stairs())
     {
@@ -3132,6 +3358,30 @@ static void _populate_stair_distances(const level_pos &target)
     }
 }
 
+static bool _loadlev_populate_stair_distances(const level_pos &target)
+{
+    // Use the travel costs saved when we last left the level if we have
+    // them; only saves from older versions need the level loaded.
+    const LevelInfo *li = travel_cache.find_level_info(target.id);
+    if (li && li->fill_distances_from(target.pos))
+    {
+        _record_stair_distances(target);
+        return true;
+    }
+
+    level_excursion excursion;
+    excursion.go_to(target.id);
+    _populate_stair_distances(target);
+    return true;
+}
+
+static void _populate_stair_distances(const level_pos &target)
+{
+    // Populate travel_point_distance.
+    fill_travel_point_distance(target.pos);
+    _record_stair_distances(target);
+}
+
 static bool _find_transtravel_square(const level_pos &target, bool verbose)
 {
     level_id current = level_id::current();
@@ -3505,6 +3755,7 @@ void LevelInfo::update()
     unwind_slime_wall_precomputer slime_wall_neighbours(
         !actor_slime_wall_immune(&you));
     precompute_travel_safety_grid travel_safety_calc;
+    update_travel_costs();
     update_stair_distances();
 
     vector<coord_def> transporter_positions;
@@ -3524,6 +3775,75 @@ void LevelInfo::set_distance_between_stairs(int a, int b, int dist)
     stair_distances[b * stairs.size() + a] = dist;
 }
 
+void LevelInfo::update_travel_costs()
+{
+    travel_costs.init(0);
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        const coord_def p(*ri);
+        if (is_travelsafe_square(p))
+            travel_costs(p) = _feature_traverse_cost(env.map_knowledge(p).feat());
+    }
+    travel_costs_valid = true;
+}
+
+// The same flood as travel_pathfind in floodout mode, but over the recorded
+// travel costs rather than the live map. Squares that were unsafe are never
+// entered; squares that are slow to cross are expanded late, as in
+// travel_pathfind::square_slows_movement(). The second flood over hostile
+// terrain is skipped, since it only yields distances that stair travel
+// treats as unreachable anyway.
+bool LevelInfo::fill_distances_from(const coord_def &pos) const
+{
+    if (!travel_costs_valid)
+        return false;
+
+    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
+
+    vector<coord_def> circumference, next;
+    circumference.push_back(pos);
+
+    auto flood = [&](const coord_def &dc, int dist)
+    {
+        if (in_bounds(dc) && travel_costs(dc)
+            && !travel_point_distance[dc.x][dc.y])
+        {
+            travel_point_distance[dc.x][dc.y] = dist;
+            next.push_back(dc);
+        }
+    };
+
+    for (int traveled_distance = 1; !circumference.empty();
+         ++traveled_distance, circumference.swap(next), next.clear())
+    {
+        for (const coord_def &c : circumference)
+        {
+            if (!in_bounds(c))
+                continue;
+
+            const int cost = travel_costs(c);
+            if (cost > 1
+                && travel_point_distance[c.x][c.y] > traveled_distance - cost)
+            {
+                next.push_back(c);
+                continue;
+            }
+
+            for (int dir = 0; dir < 8; (dir += 2) == 8 && (dir = 1))
+                flood(c + Compass[dir], traveled_distance);
+
+            if (!cost)
+                continue;
+
+            for (const transporter_info &ti : transporters)
+                if (ti.position == c && ti.destination != INVALID_COORD)
+                    flood(ti.destination, traveled_distance);
+        }
+    }
+
+    return true;
+}
+
 void LevelInfo::update_stair_distances()
 {
     const int nstairs = stairs.size();
@@ -3533,9 +3853,9 @@ void LevelInfo::update_stair_distances()
     {
         set_distance_between_stairs(s, s, 0);
 
-        // For each stair, we need to ask travel to populate the distance
-        // array.
-        fill_travel_point_distance(stairs[s].position);
+        // For each stair, populate the distance array from the travel
+        // costs we just recorded.
+        fill_distances_from(stairs[s].position);
 
         // Assume movement distance between stairs is commutative,
         // i.e. going from a->b is the same distance as b->a.
@@ -3922,6 +4242,10 @@ void LevelInfo::save(writer& outf) const
     marshallByte(outf, NUM_DACTION_COUNTERS);
     for (int i = 0; i < NUM_DACTION_COUNTERS; i++)
         marshallShort(outf, daction_counters[i]);
+
+    marshallBoolean(outf, travel_costs_valid);
+    if (travel_costs_valid)
+        marshallGridRuns(outf, travel_costs, [](uint8_t c) { return c; });
 }
 
 void LevelInfo::load(reader& inf, int minorVersion)
@@ -3973,6 +4297,18 @@ void LevelInfo::load(reader& inf, int minorVersion)
     ASSERT_RANGE(n_count, 0, NUM_DACTION_COUNTERS + 1);
     for (int i = 0; i < n_count; i++)
         daction_counters[i] = unmarshallShort(inf);
+
+    travel_costs.init(0);
+    travel_costs_valid = false;
+#if TAG_MAJOR_VERSION == 34
+    if (minorVersion >= TAG_MINOR_TRAVEL_COSTS)
+#endif
+    if (unmarshallBoolean(inf))
+    {
+        unmarshallGridRuns(inf, travel_costs,
+                           [](uint8_t &c, uint64_t value) { c = value; });
+        travel_costs_valid = true;
+    }
 }
 
 void LevelInfo::fixup()
@@ -4553,6 +4889,7 @@ bool runrest::diag_run_passes_door() const
 
 void runrest::stop(bool clear_delays)
 {
+    _travel_steps.clear();
     bool need_redraw =
         (runmode > 0 || runmode < 0 && Options.travel_delay == -1);
     _userdef_run_stoprunning_hook();
@@ -12,6 +12,7 @@
 #include "command-type.h"
 #include "daction-type.h"
 #include "exclude.h"
+#include "fixedarray.h"
 #include "travel-defs.h"
 
 class reader;
@@ -326,9 +327,11 @@ public:
 // Information on a level that interlevel travel needs.
 struct LevelInfo
 {
-    LevelInfo() : stairs(), excludes(), stair_distances(), id()
+    LevelInfo() : stairs(), excludes(), stair_distances(), id(),
+                  travel_costs_valid(false)
     {
         daction_counters.init(0);
+        travel_costs.init(0);
     }
 
     void save(writer&) const;
@@ -364,6 +367,11 @@ struct LevelInfo
     // or does not exist in our list of stairs, returns 0.
     int distance_between(const stair_info *s1, const stair_info *s2) const;
 
+    // Fills travel_point_distance with travel distances from pos, using the
+    // travel costs recorded the last time this level was updated, so the
+    // level itself need not be loaded. Returns false if there's no record.
+    bool fill_distances_from(const coord_def &pos) const;
+
     void update_excludes();
     void update();              // Update LevelInfo to be correct for the
                                 // current level.
@@ -390,6 +398,7 @@ private:
 
     void correct_stair_list(const vector<coord_def> &s);
     void correct_transporter_list(const vector<coord_def> &s);
+    void update_travel_costs();
     void update_stair_distances();
     void sync_all_branch_stairs();
     void sync_branch_stairs(const stair_info *si);
@@ -406,6 +415,11 @@ private:
     vector<short> stair_distances;  // Dist between stairs
     level_id id;
 
+    // Cost of stepping onto each square as of the last update(), or 0 if
+    // the square wasn't safe to travel over.
+    FixedArray<uint8_t, GXM, GYM> travel_costs;
+    bool travel_costs_valid;
+
     friend class TravelCache;
 
 private:
@@ -491,6 +505,8 @@ private:
 // travel pathfinding directly (but is used internally by interlevel travel).
 // * All coordinates are grid coords.
 // * Do not reuse one travel_pathfind for different runmodes.
+struct travel_flood_record;
+
 class travel_pathfind
 {
 public:
@@ -513,6 +529,10 @@ public:
     // true.
     void set_feature_vector(vector<coord_def> *features);
 
+    // Record which squares the flood looked at and the order it expanded
+    // them in; only meaningful for RMODE_TRAVEL without fallback.
+    void set_flood_record(travel_flood_record *record);
+
     // Extract features without pathfinding
     void get_features();
 
@@ -618,6 +638,8 @@ protected:
     // Attempt to path through temporary obstructions (like sealed doors)
     // due to the possibility they are no longer obstructing us
     bool try_fallback;
+
+    travel_flood_record *record;
 };
 
 extern TravelCache travel_cache;
@@ -995,6 +995,9 @@ void animation_delay(unsigned int ms, bool do_refresh)
 {
     // this leaves any Options.use_animations & UA_BEAM checks to the caller;
     // but maybe it could be refactored into here
+    if (crawl_state.arena_headless)
+        return;
+
     if (do_refresh)
     {
         viewwindow(false);
@@ -239,6 +239,12 @@ ssl_port = 8081
 
 # use_gzip = True
 
+# Ask games to send map cells in a packed binary form (base64 encoded inside
+# the usual JSON message) rather than as one JSON object per cell. This is
+# much cheaper for the game to encode and the browser to decode. Games from
+# versions that don't support it ignore the request.
+# packed_map_messages = False
+
 # Seconds until stale HTTP connections are closed
 # This needs a patch currently not in mainline tornado.
 # http_connection_timeout = None
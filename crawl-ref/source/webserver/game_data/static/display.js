@@ -87,6 +87,11 @@ function ($, comm, map_knowledge, view_data, monster_list, minimap,
         if (data.vgrdc)
             minimap.do_view_center_update(data.vgrdc.x, data.vgrdc.y);
 
+        // Packed cells come first: the JSON cells alongside them only hold
+        // monsters and dolls.
+        if (data.packed)
+            map_knowledge.merge(map_knowledge.unpack(data.packed));
+
         if (data.cells)
             map_knowledge.merge(data.cells);
 
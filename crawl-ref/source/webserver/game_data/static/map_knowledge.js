@@ -197,6 +197,113 @@ define(["jquery", "./enums", "./util"], function ($, enums, util) {
 
     }
 
+    var packed_flags = ["bloody", "old_blood", "silenced",
+                        "highlighted_summoner", "sanctuary", "liquefied",
+                        "quad_glow", "disjunct", "mangrove_water",
+                        "awakened_forest"];
+
+    // Decodes the "packed" cells of a map message into the same diffs as
+    // its JSON cells. See _pack_cell() in tileweb.cc for the format.
+    function unpack_cells(packed)
+    {
+        var bytes = atob(packed);
+        var pos = 0;
+
+        function uint()
+        {
+            var v = 0, mul = 1, b;
+            do
+            {
+                b = bytes.charCodeAt(pos++);
+                v += (b & 0x7f) * mul;
+                mul *= 128;
+            } while (b & 0x80);
+            return v;
+        }
+        function int()
+        {
+            var v = uint();
+            return v % 2 ? -(v + 1) / 2 : v / 2;
+        }
+        function tileidx()
+        {
+            var lo = uint() | 0, hi = uint() | 0;
+            return hi ? [lo, hi] : lo;
+        }
+
+        var vals = [];
+        if (uint() != 1)
+        {
+            console.error("Unknown packed map version");
+            return vals;
+        }
+        var gxm = uint(), ox = uint(), oy = uint();
+        var index = -1;
+        while (pos < bytes.length)
+        {
+            index += uint() + 1;
+            var mask = uint();
+            var val = {x: index % gxm - ox, y: Math.floor(index / gxm) - oy};
+            var t = {};
+
+            if (mask & 1 << 0)
+                val.f = uint();
+            if (mask & 1 << 1)
+                val.mf = uint();
+            if (mask & 1 << 2)
+                val.g = String.fromCodePoint(uint());
+            if (mask & 1 << 3)
+                val.col = uint();
+            if (mask & 1 << 4)
+                t.fg = tileidx();
+            if (mask & 1 << 5)
+                t.base = uint();
+            if (mask & 1 << 6)
+                t.bg = tileidx();
+            if (mask & 1 << 7)
+                t.cloud = tileidx();
+            if (mask & 1 << 8)
+            {
+                t.icons = [];
+                for (var n = uint(); n > 0; n--)
+                    t.icons.push(tileidx());
+            }
+            if (mask & 1 << 9)
+            {
+                var changed = uint(), values = uint();
+                for (var i = 0; i < packed_flags.length; i++)
+                    if (changed & 1 << i)
+                        t[packed_flags[i]] = !!(values & 1 << i);
+            }
+            if (mask & 1 << 10)
+                t.halo = int();
+            if (mask & 1 << 11)
+                t.orb_glow = uint();
+            if (mask & 1 << 12)
+                t.blood_rotation = int();
+            if (mask & 1 << 13)
+                t.travel_trail = uint();
+            if (mask & 1 << 14)
+            {
+                t.flv = {f: uint()};
+                var special = uint();
+                if (special)
+                    t.flv.s = special;
+            }
+            if (mask & 1 << 15)
+            {
+                t.ov = [];
+                for (var n = uint(); n > 0; n--)
+                    t.ov.push(int());
+            }
+
+            if (mask & ~0xf)
+                val.t = t;
+            vals.push(val);
+        }
+        return vals;
+    }
+
     function merge_diff(vals)
     {
         $.each(vals, function (i, val)
@@ -210,6 +317,7 @@ define(["jquery", "./enums", "./util"], function ($, enums, util) {
     return {
         get: get,
         merge: merge_diff,
+        unpack: unpack_cells,
         clear: clear,
         touch: touch,
         visible: visible,
@@ -74,6 +74,7 @@ defaults = {
     'connection_timeout': 600,
     'max_idle_time': 5 * 60 * 60,
     'use_gzip': True,
+    'packed_map_messages': False,
     'kill_timeout': 10,
     'nick_regex': r"^[a-zA-Z0-9]{3,20}$",
     'max_passwd_length': 20,
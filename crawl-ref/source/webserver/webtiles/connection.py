@@ -72,7 +72,8 @@ class WebtilesSocketConnection(object):
 
         msg = json_encode({
                 "msg": "attach",
-                "primary": primary
+                "primary": primary,
+                "packed_map": bool(config.get('packed_map_messages')),
                 })
 
         self.open = True
@@ -8,6 +8,13 @@
 #include "wiz-fsim.h"
 
 #include <cerrno>
+#include <cmath>
+#include <functional>
+
+#ifdef UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "beam.h"
 #include "bitary.h"
@@ -38,6 +45,7 @@
 #include "species.h"
 #include "state.h"
 #include "stringutil.h"
+#include "tags.h"
 #include "throw.h"
 #include "unwind.h"
 #include "version.h"
@@ -47,22 +55,37 @@
 
 typedef map<skill_type, int8_t> skill_map;
 
+// How many rounds to run between checks of whether the results have
+// converged to within fsim_precision.
+#define FSIM_CHECK_ROUNDS 1000
+
 static const char* _title_line =
-    "Source | AvHitDam | MaxDam |  Acc | AvDam | AvTime | AvSpd | AvEffDam"; // 69 columns
+    "Source | AvHitDam | MaxDam |  Acc | AvDam | AvTime | AvSpd | AvEffDam |"
+    " DamSD | EffCI95"; // 87 columns
 static const char* _tsv_title_line =
-    "Damage source\tAvHitDam\tMaxDam\tAccuracy\tAvDam\tAvTime\tAvSpeed\tAvEffDam";
+    "Damage source\tAvHitDam\tMaxDam\tAccuracy\tAvDam\tAvTime\tAvSpeed"
+    "\tAvEffDam\tDamSD\tAvEffDamCI95\tRounds";
 
 string fight_damage_stats::summary(const string prefix, bool tsv)
 {
     if (hits == 0 && !tsv)
         return make_stringf("%s%6s | No hits", prefix.c_str(), attacker.c_str());
-    return make_stringf(tsv ? "%s%s\t%.1f\t%d\t%d%%\t%.1f\t%d\t%.2f\t%.1f"
-                            : "%s%6s |    %5.1f |    %3d | %3d%% |"
-                              " %5.1f |   %3d  | %5.2f |    %5.1f",
+    if (tsv)
+    {
+        return make_stringf("%s%s\t%.1f\t%d\t%d%%\t%.1f\t%d\t%.2f\t%.1f"
+                            "\t%.2f\t%.2f\t%d",
+                            prefix.c_str(), attacker.c_str(),
+                            av_hit_dam, max_dam, accuracy,
+                            av_dam, av_time, av_speed,
+                            av_eff_dam, dam_sd, eff_dam_ci, iterations);
+    }
+    return make_stringf("%s%6s |    %5.1f |    %3d | %3d%% |"
+                        " %5.1f |   %3d  | %5.2f |    %5.1f |"
+                        " %5.1f |  +/-%4.2f",
                         prefix.c_str(), attacker.c_str(),
                         av_hit_dam, max_dam, accuracy,
                         av_dam, av_time, av_speed,
-                        av_eff_dam);
+                        av_eff_dam, dam_sd, eff_dam_ci);
 }
 
 string fight_data::header(bool tsv)
@@ -437,11 +460,22 @@ static void _do_one_fsim_round(monster &mon, fight_data &fd, bool defend)
     you.move_to_pos(you_start_pos);
 }
 
+// Whether the damage per round has a 95% confidence interval within
+// fsim_precision percent of its mean.
+static bool _fsim_converged(const fight_damage_stats &stats, int rounds)
+{
+    if (!Options.fsim_precision || !stats.cumulative_damage)
+        return false;
+
+    const double mean = double(stats.cumulative_damage) / rounds;
+    const double ci = 1.96 * stats.damage_sd(rounds) / sqrt(rounds);
+    return ci * 100 <= mean * Options.fsim_precision;
+}
+
 static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
 {
     const monster orig = mon;
     fight_data fdata;
-    fdata.monster.iterations = fdata.player.iterations = iter_limit;
 
     // now make sure the player is ready
     unwind_var<int> exp_available(you.exp_available, 0);
@@ -457,8 +491,19 @@ static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
     {
         msg::suppress mx;
 
-        for (int i = 0; i < iter_limit; i++)
+        const fight_damage_stats &attacker = defend ? fdata.monster
+                                                    : fdata.player;
+        int rounds = 0;
+        while (rounds < iter_limit)
+        {
             _do_one_fsim_round(mon, fdata, defend);
+            if (++rounds % FSIM_CHECK_ROUNDS == 0
+                && _fsim_converged(attacker, rounds))
+            {
+                break;
+            }
+        }
+        fdata.monster.iterations = fdata.player.iterations = rounds;
     }
 
     fdata.player.calc_output_stats();
@@ -470,10 +515,23 @@ static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
 void fight_damage_stats::damage(int amount)
 {
     cumulative_damage += amount;
+    cumulative_sq_damage += uint64_t(amount) * amount;
     if (amount > max_dam)
         max_dam = amount;
 }
 
+// The sample standard deviation of the damage per round.
+double fight_damage_stats::damage_sd(int rounds) const
+{
+    if (rounds < 2)
+        return 0.0;
+
+    const double mean = double(cumulative_damage) / rounds;
+    const double var = (double(cumulative_sq_damage) / rounds - mean * mean)
+                       * rounds / (rounds - 1);
+    return sqrt(max(var, 0.0));
+}
+
 void fight_damage_stats::calc_output_stats()
 {
     av_hit_dam = hits ? double(cumulative_damage) / hits : 0.0;
@@ -482,6 +540,11 @@ void fight_damage_stats::calc_output_stats()
     av_time = double(time_taken) / iterations + 0.5; // round to nearest
     av_speed = double(iterations) * 100 / time_taken;
     av_eff_dam = av_dam * 100 / av_time;
+    dam_sd = damage_sd(iterations);
+    // This treats the time per round as fixed, which it is for monsters and
+    // nearly is for the player.
+    eff_dam_ci = av_time ? 1.96 * dam_sd / sqrt(iterations) * 100 / av_time
+                         : 0.0;
 }
 
 fight_data wizard_quick_fsim_raw(bool defend)
@@ -518,6 +581,165 @@ void wizard_quick_fsim()
     return;
 }
 
+#ifdef UNIX
+static void _marshall_fight_stats(writer &outf,
+                                  const fight_damage_stats &stats)
+{
+    marshallInt(outf, stats.cumulative_damage);
+    marshallUnsigned(outf, stats.cumulative_sq_damage);
+    marshallInt(outf, stats.time_taken);
+    marshallInt(outf, stats.hits);
+    marshallInt(outf, stats.iterations);
+    marshallInt(outf, stats.max_dam);
+}
+
+static void _unmarshall_fight_stats(reader &inf, fight_damage_stats &stats)
+{
+    stats.cumulative_damage = unmarshallInt(inf);
+    stats.cumulative_sq_damage = unmarshallUnsigned(inf);
+    stats.time_taken = unmarshallInt(inf);
+    stats.hits = unmarshallInt(inf);
+    stats.iterations = unmarshallInt(inf);
+    stats.max_dam = unmarshallInt(inf);
+    stats.calc_output_stats();
+}
+
+/**
+ * Run the points of a sweep in fsim_jobs forked copies of the game, each
+ * fighting its own copy of the player and monster.
+ *
+ * @returns Whether every point's results came back.
+ */
+static bool _run_fsim_workers(monster &mon, bool defend, uint64_t seed,
+                              function<void(int)> setup,
+                              vector<fight_data> &results)
+{
+    const int points = results.size();
+    const int jobs = min(Options.fsim_jobs, points);
+    vector<pid_t> workers;
+    vector<FILE *> pipes;
+
+    for (int job = 0; job < jobs; ++job)
+    {
+        int fds[2];
+        if (pipe(fds) == -1)
+            break;
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+
+        if (!pid)
+        {
+            close(fds[0]);
+            for (FILE *other : pipes)
+                fclose(other);
+
+            FILE *outf = fdopen(fds[1], "wb");
+            {
+                writer w("fsim worker", outf);
+                for (int p = job; p < points; p += jobs)
+                {
+                    setup(p);
+                    rng::subgenerator stream(seed, p);
+                    fight_data fdata = _get_fight_data(mon,
+                                                       Options.fsim_rounds,
+                                                       defend);
+                    _marshall_fight_stats(w, fdata.player);
+                    _marshall_fight_stats(w, fdata.monster);
+                }
+            }
+            fclose(outf);
+            // The terminal and game state belong to the parent.
+            _exit(0);
+        }
+
+        close(fds[1]);
+        workers.push_back(pid);
+        pipes.push_back(fdopen(fds[0], "rb"));
+    }
+
+    bool success = (int)workers.size() == jobs;
+    for (unsigned int job = 0; job < workers.size(); ++job)
+    {
+        try
+        {
+            reader r(pipes[job]);
+            for (int p = job; success && p < points; p += jobs)
+            {
+                _unmarshall_fight_stats(r, results[p].player);
+                _unmarshall_fight_stats(r, results[p].monster);
+            }
+        }
+        catch (short_read_exception &E)
+        {
+            success = false;
+        }
+        fclose(pipes[job]);
+
+        int status;
+        if (waitpid(workers[job], &status, 0) == -1
+            || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            success = false;
+        }
+    }
+    return success;
+}
+#endif
+
+/**
+ * Run the fights for every point of a sweep, such as each skill level of
+ * a simple scale simulation.
+ *
+ * Each point gets its own random stream, so the results do not depend on
+ * how many fsim_jobs share the work.
+ *
+ * @param setup  Sets up the player for a point.
+ * @param report Reports the results for a point, in order of points.
+ *               Returns false to cancel the rest of the sweep.
+ */
+static void _run_fsim_sweep(monster &mon, bool defend, int points,
+                            function<void(int)> setup,
+                            function<bool(int, fight_data &)> report)
+{
+    const uint64_t seed = rng::get_uint64();
+
+#ifdef UNIX
+    if (Options.fsim_jobs > 1 && points > 1)
+    {
+        mprf("Running %d fight simulations in %d processes...", points,
+             min(Options.fsim_jobs, points));
+        vector<fight_data> results(points);
+        if (_run_fsim_workers(mon, defend, seed, setup, results))
+        {
+            for (int p = 0; p < points; ++p)
+                if (!report(p, results[p]))
+                    break;
+            return;
+        }
+        mprf(MSGCH_ERROR, "Parallel fight simulation failed, running it "
+                          "serially.");
+    }
+#endif
+
+    for (int p = 0; p < points; ++p)
+    {
+        setup(p);
+        fight_data fdata;
+        {
+            rng::subgenerator stream(seed, p);
+            fdata = _get_fight_data(mon, Options.fsim_rounds, defend);
+        }
+        if (!report(p, fdata))
+            return;
+    }
+}
+
 static string _init_scale(skill_map &scale, bool &xl_mode)
 {
     string ret;
@@ -592,20 +814,21 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
     mpr(text_title);
 
     vector<pair<int, fight_data>> results;
-    const int iter_limit = Options.fsim_rounds;
-    for (int i = xl_mode ? 1 : 0; i <= 27; i++)
+    const int first = xl_mode ? 1 : 0;
+    auto setup = [&](int p)
     {
-        clear_messages();
-
         if (xl_mode)
-            set_xl(i, true);
+            set_xl(first + p, true);
         else
         {
             for (const auto &entry : scale)
-                set_skill_level(entry.first, i / entry.second);
+                set_skill_level(entry.first, (first + p) / entry.second);
         }
-
-        fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
+    };
+    auto report = [&](int p, fight_data &fdata)
+    {
+        const int i = first + p;
+        clear_messages();
         results.emplace_back(i, fdata);
         fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
         const string line = fstats.summary(make_stringf("%2d | ", i), false);
@@ -621,9 +844,12 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
         {
             mpr("Cancelling simulation.\n");
             fprintf(o, "Simulation cancelled!\n\n");
-            break;
+            return false;
         }
-    }
+        return true;
+    };
+    _run_fsim_sweep(*mon, defense, 28 - first, setup, report);
+
     // if there was any retaliatory damage, report that. Don't report a row if
     // there were no hits; for attacking most monsters would have all 0s here.
     for (auto &fdata : results)
@@ -665,32 +891,39 @@ static void _fsim_double_scale(FILE * o, monster* mon, bool defense)
 
     fprintf(o,"\n");
 
-    const int iter_limit = Options.fsim_rounds;
-    for (int y = 1; y <= 27; y += 2)
+    // Skill levels 1, 3, ..., 27 on each axis.
+    const int steps = 14;
+    auto setup = [&](int p)
     {
-        fprintf(o, Options.fsim_csv ? "%d\t" : "%2d", y);
-        for (int x = 1; x <= 27; x += 2)
-        {
-            clear_messages();
-            set_skill_level(skx, x);
-            set_skill_level(sky, y);
-            fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
-            fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
-            mprf("%s %d, %s %d: %d", skill_name(skx), x, skill_name(sky), y,
-                 int(fstats.av_eff_dam));
-            fprintf(o,Options.fsim_csv ? "%.1f\t" : "%5.1f", fstats.av_eff_dam);
-            fflush(o);
+        set_skill_level(skx, 1 + p % steps * 2);
+        set_skill_level(sky, 1 + p / steps * 2);
+    };
+    auto report = [&](int p, fight_data &fdata)
+    {
+        const int x = 1 + p % steps * 2;
+        const int y = 1 + p / steps * 2;
+        if (x == 1)
+            fprintf(o, Options.fsim_csv ? "%d\t" : "%2d", y);
 
-            // kill the loop if the user hits escape
-            if (kbhit() && getch_ck() == 27)
-            {
-                mpr("Cancelling simulation.\n");
-                fprintf(o, "\nSimulation cancelled!\n\n");
-                return;
-            }
+        clear_messages();
+        fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
+        mprf("%s %d, %s %d: %d", skill_name(skx), x, skill_name(sky), y,
+             int(fstats.av_eff_dam));
+        fprintf(o,Options.fsim_csv ? "%.1f\t" : "%5.1f", fstats.av_eff_dam);
+        if (x == 27)
+            fprintf(o,"\n");
+        fflush(o);
+
+        // kill the loop if the user hits escape
+        if (kbhit() && getch_ck() == 27)
+        {
+            mpr("Cancelling simulation.\n");
+            fprintf(o, "\nSimulation cancelled!\n\n");
+            return false;
         }
-        fprintf(o,"\n");
-    }
+        return true;
+    };
+    _run_fsim_sweep(*mon, defense, steps * steps, setup, report);
 }
 
 void wizard_fight_sim(bool double_scale)
@@ -5,25 +5,29 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 using std::string;
 
 struct fight_damage_stats
 {
-    fight_damage_stats(string att) : cumulative_damage(0), time_taken(0), hits(0),
+    fight_damage_stats(string att) : cumulative_damage(0),
+            cumulative_sq_damage(0), time_taken(0), hits(0),
             iterations(1), attacker(att),
             av_hit_dam(0.0), max_dam(0), accuracy(0), av_dam(0.0), av_time(0),
-            av_speed(0.0), av_eff_dam(0.0)
+            av_speed(0.0), av_eff_dam(0.0), dam_sd(0.0), eff_dam_ci(0.0)
     {};
 
     void calc_output_stats();
     void damage(int amount);
+    double damage_sd(int rounds) const;
 
     string summary(const string prefix, bool tsv);
 
     // used while running an fsim
     unsigned int cumulative_damage;
+    uint64_t cumulative_sq_damage;
     int time_taken;
     int hits;
     int iterations;
@@ -38,6 +42,8 @@ struct fight_damage_stats
     int av_time;
     double av_speed;
     double av_eff_dam;
+    double dam_sd;     // standard deviation of the damage per round
+    double eff_dam_ci; // half-width of the 95% confidence interval of AvEffDam
 };
 
 struct fight_data